@@ -23,6 +23,9 @@
 
 // BST_TEST_CASE(symbol) - define and register a test case
 // BST_TEMPLATE_TEST_CASE_{1..8}(symbol, T, T1, ...) - define and register a templated test case
+// BST_BENCHMARK_CASE(symbol) - define and register a test case that isn't run by default, e.g. a benchmark which reports
+// its results with BST_MESSAGE; to run these, use the "[benchmark]" tag with Catch, --gtest_also_run_disabled_tests with
+// Google Test, or --run_test=symbol with the Boost Test library (1.59 or later, and --log_level=message to see the results)
 
 ////////////////////////////////////////////////////////////////////////////////////////////
 // Making test assertions
@@ -33,6 +36,7 @@
 // BST_{REQUIRE,CHECK,WARN}_THROW(expr, exception) - test expression throws the indicated exception type
 // BST_{REQUIRE,CHECK,WARN}_TRY - introduce a test of an exception-throwing statement
 // BST_{REQUIRE,CHECK,WARN}_CATCH(exception) - test the preceding statement throws the indicated exception type
+// BST_MESSAGE(message) - report a message, which may be a stream expression, e.g. the results of a benchmark
 //
 // Note: Not all combinations of level/flavour {REQUIRE,CHECK,WARN} and comparison {EQUAL,NE,GE,LE} may yet be
 // implemented below, but can easily be added
@@ -261,6 +265,7 @@ PRAGMA_WARNING_POP
 //- Add "test templates" for Catch
 
 #define BST_TEST_CASE(symbol) CATCH_TEST_CASE(#symbol)
+#define BST_BENCHMARK_CASE(symbol) CATCH_TEST_CASE(#symbol, "[.][benchmark]")
 #define BST_CHECK_EQUAL(expected, actual) CATCH_CHECK((expected) == (actual))
 #define BST_CHECK_NE(expected, actual) CATCH_CHECK((expected) != (actual))
 #define BST_CHECK_THROW(expr, exception) CATCH_CHECK_THROWS_AS(expr, exception)
@@ -273,6 +278,7 @@ PRAGMA_WARNING_POP
 #define BST_WARN(expr) CATCH_CHECK_NOFAIL(expr)
 #define BST_WARN_EQUAL(expected, actual) CATCH_CHECK_NOFAIL((expected) == (actual))
 #define BST_WARN_NE(expected, actual) CATCH_CHECK_NOFAIL((expected) != (actual))
+#define BST_MESSAGE(message) CATCH_WARN(message)
 
 // Extension to workaround different behaviour of Catch and Boost Test library when comparing char*
 #define BST_CHECK_STRING_EQUAL(expected, actual) CATCH_CHECK(std::string(expected) == std::string(actual))
@@ -341,6 +347,7 @@ PRAGMA_WARNING_POP
 //- Break BOOST_CHECK_THROW_IMPL in two so the statement can contain commas, etc.
 
 #define BST_TEST_CASE(symbol) BOOST_AUTO_TEST_CASE(symbol)
+#define BST_BENCHMARK_CASE(symbol) BOOST_AUTO_TEST_CASE(symbol, *boost::unit_test::disabled())
 #define BST_CHECK_EQUAL(expected, actual) BOOST_CHECK_EQUAL(expected, actual)
 #define BST_CHECK_NE(expected, actual) BOOST_CHECK_NE(expected, actual)
 #define BST_CHECK_THROW(expr, exception) BOOST_CHECK_THROW(expr, exception) 
@@ -353,6 +360,7 @@ PRAGMA_WARNING_POP
 #define BST_WARN(expr) BOOST_WARN(expr)
 #define BST_WARN_EQUAL(expected, actual) BOOST_WARN_EQUAL(expected, actual)
 #define BST_WARN_NE(expected, actual) BOOST_WARN_NE(expected, actual)
+#define BST_MESSAGE(message) BOOST_TEST_MESSAGE(message)
 
 // Extension to workaround different behaviour of Catch and Boost Test library when comparing char*
 #define BST_CHECK_STRING_EQUAL(expected, actual) BOOST_CHECK_EQUAL(expected, actual)
@@ -410,6 +418,8 @@ PRAGMA_WARNING_POP
 #define GTEST_HAS_TR1_TUPLE 0
 #define GTEST_USE_OWN_TR1_TUPLE 1
 
+#include <iostream>
+
 #ifndef BST_TEST_MAIN
 
 #include "gtest/gtest.h"
@@ -482,6 +492,7 @@ PRAGMA_WARNING_POP
 //- Tweak TYPED_TEST so we can give a custom name to the type parameter
 
 #define BST_TEST_CASE(symbol) TEST(bstTestCase, symbol)
+#define BST_BENCHMARK_CASE(symbol) TEST(bstBenchmarkCase, DISABLED_ ## symbol)
 #define BST_CHECK_EQUAL(expected, actual) EXPECT_EQ(expected, actual)
 #define BST_CHECK_NE(expected, actual) EXPECT_NE(expected, actual)
 #define BST_CHECK_THROW(expr, exception) EXPECT_THROW(expr, exception)
@@ -495,6 +506,8 @@ PRAGMA_WARNING_POP
 #define BST_WARN(expr) EXPECT_TRUE(expr)
 #define BST_WARN_EQUAL(expected, actual) EXPECT_EQ(expected, actual)
 #define BST_WARN_NE(expected, actual) EXPECT_NE(expected, actual)
+// Google Test has no equivalent, so just write to stdout
+#define BST_MESSAGE(message) (std::cout << message << std::endl)
 
 #define BST_CHECK_STRING_EQUAL(expected, actual) EXPECT_STREQ(expected, actual)
 #define BST_REQUIRE_STRING_EQUAL(expected, actual) ASSERT_STREQ(expected, actual)
@@ -560,4 +573,13 @@ PRAGMA_WARNING_POP
   } \
   template <> void ::detail::test_private<symbol ## _private_tag>()
 
+#define BST_BENCHMARK_CASE_PRIVATE(symbol) \
+  namespace { struct symbol ## _private_tag; } \
+  template <> void ::detail::test_private<symbol ## _private_tag>(); \
+  BST_BENCHMARK_CASE(symbol) \
+  { \
+    ::detail::test_private<symbol ## _private_tag>(); \
+  } \
+  template <> void ::detail::test_private<symbol ## _private_tag>()
+
 #endif
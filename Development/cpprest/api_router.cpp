@@ -58,10 +58,13 @@ namespace web
                 bool api_router::operator()(const web::http::http_request& req, web::http::http_response& res, const utility::string_t& route_path, const route_parameters& parameters)
                 {
                     const utility::string_t path = get_route_relative_path(req, route_path); // required, as must live longer than the match results
-                    for (auto route : routes)
+                    for (const auto& route : routes)
                     {
+                        // cheap rejection of most non-matching routes, before trying the regex
+                        if (!route_prefix_match(path, route.route_prefix)) continue;
+
                         utility::smatch_t route_match;
-                        if (route_regex_match(path, route_match, utility::regex_t(route.route_pattern.first), route.flags))
+                        if (route_regex_match(path, route_match, route.route_regex, route.flags))
                         {
                             // route_path for this route handler is constructed by appending the entire matching expression
                             const auto merged_path = route_path + route_match.str();
@@ -144,7 +147,11 @@ namespace web
 
                 api_router::const_iterator api_router::insert(const_iterator where, match_flag_type flags, const utility::string_t& route_pattern, const web::http::method& method, route_handler handler)
                 {
-                    return routes.insert(where, { flags, utility::parse_regex_named_sub_matches(route_pattern), method, handler });
+                    auto regex_named_sub_matches = utility::parse_regex_named_sub_matches(route_pattern);
+                    // construct the regex once and for all, since it's by far the most expensive part of matching a request against a route
+                    utility::regex_t route_regex(regex_named_sub_matches.first);
+                    auto route_prefix = get_route_prefix(regex_named_sub_matches.first);
+                    return routes.insert(where, { flags, std::move(regex_named_sub_matches), std::move(route_regex), std::move(route_prefix), method, handler });
                 }
 
                 route_parameters api_router::get_parameters(const utility::named_sub_matches_t& parameter_sub_matches, const utility::smatch_t& route_match)
@@ -174,6 +181,53 @@ namespace web
                         ? std::regex_search(path, route_match, route_regex, std::regex_constants::match_continuous)
                         : std::regex_match(path, route_match, route_regex);
                 }
+
+                bool api_router::route_prefix_match(const utility::string_t& path, const utility::string_t& route_prefix)
+                {
+                    // both match_entire and match_prefix routes are anchored at the start of the path
+                    return path.size() >= route_prefix.size() && 0 == path.compare(0, route_prefix.size(), route_prefix);
+                }
+
+                utility::string_t api_router::get_route_prefix(const utility::string_t& route_regex)
+                {
+                    // the literal prefix is the longest leading sequence of ordinary characters that every match must start with
+                    // e.g. "/x-nmos/(query)/(v1\.[0-2])/?" has the literal prefix "/x-nmos/"
+                    // this is deliberately conservative, so an escaped character ends the prefix, as does the first special character,
+                    // and when that is a quantifier, the preceding character must be dropped since it may be optional or repeated
+
+                    // a top-level alternative means there's no common prefix, without a great deal more effort
+                    int depth = 0;
+                    bool escaped = false;
+                    bool bracketed = false;
+                    for (auto ch : route_regex)
+                    {
+                        if (escaped) { escaped = false; continue; }
+                        if (bracketed) { if (U(']') == ch) bracketed = false; else if (U('\\') == ch) escaped = true; continue; }
+                        switch (ch)
+                        {
+                        case U('\\'): escaped = true; break;
+                        case U('['): bracketed = true; break;
+                        case U('('): ++depth; break;
+                        case U(')'): --depth; break;
+                        case U('|'): if (0 == depth) return{}; break;
+                        default: break;
+                        }
+                    }
+
+                    const utility::string_t specials{ U("\\^$.|?*+()[]{}") };
+                    const utility::string_t quantifiers{ U("?*+{") };
+
+                    const auto found = route_regex.find_first_of(specials);
+                    if (utility::string_t::npos == found)
+                    {
+                        return route_regex;
+                    }
+                    if (utility::string_t::npos != quantifiers.find(route_regex[found]))
+                    {
+                        return 0 == found ? utility::string_t{} : route_regex.substr(0, found - 1);
+                    }
+                    return route_regex.substr(0, found);
+                }
             }
         }
     }
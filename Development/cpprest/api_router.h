@@ -60,7 +60,9 @@ namespace web
 
                 private:
                     enum match_flag_type { match_entire = 0, match_prefix = 1 };
-                    struct route { match_flag_type flags; utility::regex_named_sub_matches_t route_pattern; web::http::method method; route_handler handler; };
+                    // the route regex is compiled once when the route is added, rather than on every request, and the literal prefix of the pattern
+                    // (if any) allows most non-matching routes to be skipped with a simple string comparison rather than a regex match
+                    struct route { match_flag_type flags; utility::regex_named_sub_matches_t route_pattern; utility::regex_t route_regex; utility::string_t route_prefix; web::http::method method; route_handler handler; };
                     typedef std::list<route> route_handlers;
                     typedef route_handlers::const_iterator const_iterator;
 
@@ -69,6 +71,8 @@ namespace web
                     static route_parameters get_parameters(const utility::named_sub_matches_t& parameter_sub_matches, const utility::smatch_t& route_match);
                     static route_parameters insert(route_parameters&& into, const route_parameters& range);
                     static bool route_regex_match(const utility::string_t& path, utility::smatch_t& route_match, const utility::regex_t& route_regex, match_flag_type flags);
+                    static bool route_prefix_match(const utility::string_t& path, const utility::string_t& route_prefix);
+                    static utility::string_t get_route_prefix(const utility::string_t& route_regex);
 
                     // to allow routes to be added out-of-order, support() and mount() could easily be given overloads that accept and return a const_iterator
                     const_iterator insert(const_iterator where, match_flag_type flags, const utility::string_t& route_pattern, const web::http::method& method, route_handler handler);
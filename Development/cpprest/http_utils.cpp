@@ -1,8 +1,12 @@
 #include "cpprest/http_utils.h"
 
+#include <chrono>
 #include <map>
 #include <set>
+#include <thread>
+#include <vector>
 #include "cpprest/basic_utils.h" // for utility::istringstreamed
+#include "cpprest/producerconsumerstream.h"
 #include "detail/private_access.h"
 
 namespace web
@@ -56,6 +60,251 @@ namespace web
             res.set_body(body_data);
         }
 
+        namespace details
+        {
+            inline bool is_high_surrogate(char) { return false; }
+            inline bool is_high_surrogate(wchar_t c) { return 0xD800 <= c && c <= 0xDBFF; }
+
+            // a streambuf which writes text, UTF-8 encoded, to a producer-consumer buffer in reasonably sized chunks, waiting
+            // while too much is already waiting to be consumed, and giving up if the consumer stops making progress altogether
+            class producer_streambuf : public std::basic_streambuf<utility::char_t>
+            {
+            public:
+                producer_streambuf(concurrency::streams::producer_consumer_buffer<uint8_t> producer, size_t chunk_size, size_t max_buffered, std::chrono::steady_clock::duration stall_timeout, const std::atomic<bool>& stopping)
+                    : producer(producer)
+                    , chunk(chunk_size)
+                    , max_buffered(max_buffered)
+                    , stall_timeout(stall_timeout)
+                    , stopping(stopping)
+                {
+                    setp(chunk.data(), chunk.data() + chunk.size());
+                }
+
+            protected:
+                virtual int_type overflow(int_type ch)
+                {
+                    flush_chunk();
+                    if (!traits_type::eq_int_type(ch, traits_type::eof()))
+                    {
+                        *pptr() = traits_type::to_char_type(ch);
+                        pbump(1);
+                    }
+                    return traits_type::not_eof(ch);
+                }
+
+                virtual int sync()
+                {
+                    flush_chunk();
+                    return 0;
+                }
+
+            private:
+                void flush_chunk()
+                {
+                    utility::char_t* last = pptr();
+                    // don't split a UTF-16 surrogate pair between chunks, since each chunk is converted to UTF-8 separately
+                    const bool split = pbase() != last && is_high_surrogate(*(last - 1));
+                    if (split) --last;
+
+                    const auto utf8 = utility::conversions::to_utf8string(utility::string_t(pbase(), last));
+
+                    // wait for the consumer to catch up
+                    // (the buffer doesn't signal when it is read, so poll, backing off while the consumer makes no progress)
+                    auto avail = producer.in_avail();
+                    auto progress = std::chrono::steady_clock::now();
+                    auto interval = std::chrono::milliseconds(1);
+                    while (max_buffered < avail)
+                    {
+                        if (stopping) throw std::runtime_error("response body abandoned");
+                        if (!producer.can_write()) throw std::runtime_error("response body closed");
+
+                        std::this_thread::sleep_for(interval);
+
+                        const auto now = std::chrono::steady_clock::now();
+                        const auto still_avail = producer.in_avail();
+                        if (still_avail < avail)
+                        {
+                            progress = now;
+                            interval = std::chrono::milliseconds(1);
+                        }
+                        else
+                        {
+                            if (stall_timeout < now - progress) throw std::runtime_error("response body stalled");
+                            interval = (std::min)(interval * 2, std::chrono::milliseconds(50));
+                        }
+                        avail = still_avail;
+                    }
+
+                    if (!utf8.empty())
+                    {
+                        producer.putn_nocopy((const uint8_t*)utf8.data(), utf8.size()).wait();
+                    }
+
+                    setp(chunk.data(), chunk.data() + chunk.size());
+                    if (split)
+                    {
+                        *pptr() = *last;
+                        pbump(1);
+                    }
+                }
+
+                concurrency::streams::producer_consumer_buffer<uint8_t> producer;
+                std::vector<utility::char_t> chunk;
+                size_t max_buffered;
+                std::chrono::steady_clock::duration stall_timeout;
+                const std::atomic<bool>& stopping;
+            };
+        }
+
+        streamed_reply_pool::streamed_reply_pool(std::size_t threads, std::size_t max_queued)
+            : max_queued(max_queued)
+            , stopping(false)
+        {
+            for (std::size_t i = 0; i < threads; ++i)
+            {
+                this->threads.push_back(std::thread([this] { run(); }));
+            }
+        }
+
+        streamed_reply_pool::~streamed_reply_pool()
+        {
+            stop();
+        }
+
+        void streamed_reply_pool::stop()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            condition.notify_all();
+            for (auto& thread : threads)
+            {
+                thread.join();
+            }
+            threads.clear();
+
+            // any jobs still waiting (only if there were no threads) are called so that they can abandon their response bodies
+            std::deque<job_type> abandoned;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                abandoned.swap(jobs);
+            }
+            for (auto& job : abandoned)
+            {
+                job(stopping);
+            }
+        }
+
+        bool streamed_reply_pool::try_post(job_type job)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (stopping || max_queued <= jobs.size()) return false;
+                jobs.push_back(std::move(job));
+            }
+            condition.notify_one();
+            return true;
+        }
+
+        void streamed_reply_pool::run()
+        {
+            for (;;)
+            {
+                job_type job;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    condition.wait(lock, [this] { return stopping || !jobs.empty(); });
+                    if (jobs.empty()) return;
+                    job = std::move(jobs.front());
+                    jobs.pop_front();
+                }
+                // once stopping, the remaining jobs are still called, but should give up immediately
+                job(stopping);
+            }
+        }
+
+        void set_streamed_reply(web::http::http_response& res, web::http::status_code code, std::function<void(utility::ostream_t&)> write_body, streamed_reply_pool& pool, const utility::string_t& content_type)
+        {
+            concurrency::streams::producer_consumer_buffer<uint8_t> buffer;
+            const auto body = buffer.create_istream();
+
+            // the body is produced on one of the pool's threads rather than a task, since waiting for the consumer could otherwise
+            // tie up the thread pool which is needed to send the response
+            const bool posted = pool.try_post([buffer, write_body](const std::atomic<bool>& stopping) mutable
+            {
+                try
+                {
+                    if (stopping) throw std::runtime_error("response body abandoned");
+                    details::producer_streambuf streambuf(buffer, 16 * 1024, 64 * 1024, std::chrono::seconds(30), stopping);
+                    utility::ostream_t os(&streambuf);
+                    os.exceptions(std::ios_base::badbit);
+                    write_body(os);
+                    os.flush();
+                    buffer.close(std::ios_base::out).wait();
+                }
+                catch (...)
+                {
+                    // so that the response is aborted rather than appearing complete
+                    buffer.close(std::ios_base::out, std::current_exception()).wait();
+                }
+            });
+
+            if (posted)
+            {
+                // no content length, so the body will be sent with chunked transfer encoding
+                set_reply(res, code, body, content_type);
+            }
+            else
+            {
+                utility::ostringstream_t os;
+                write_body(os);
+                set_reply(res, code, os.str(), content_type);
+            }
+        }
+
+        utility::string_t make_entity_tag(const utility::string_t& opaque_tag)
+        {
+            return U("\"") + opaque_tag + U("\"");
+        }
+
+        namespace details
+        {
+            // the weak comparison function ignores the weakness indicator, see https://tools.ietf.org/html/rfc7232#section-2.3.2
+            inline utility::string_t strip_weakness_indicator(const utility::string_t& entity_tag)
+            {
+                return 0 == entity_tag.compare(0, 2, U("W/")) ? entity_tag.substr(2) : entity_tag;
+            }
+        }
+
+        bool match_if_none_match(const web::http::http_request& req, const utility::string_t& entity_tag)
+        {
+            const auto header = req.headers().find(web::http::header_names::if_none_match);
+            if (req.headers().end() == header) return false;
+
+            // If-None-Match = "*" / 1#entity-tag
+            // (multiple header fields have already been combined into one comma-separated list)
+            const auto& list = header->second;
+            const auto strong_tag = details::strip_weakness_indicator(entity_tag);
+            utility::string_t::size_type first = 0;
+            while (first <= list.size())
+            {
+                auto last = list.find(U(','), first);
+                if (utility::string_t::npos == last) last = list.size();
+
+                const auto begin = list.find_first_not_of(U(" \t"), first);
+                if (utility::string_t::npos != begin && begin < last)
+                {
+                    const auto end = list.find_last_not_of(U(" \t"), last - 1) + 1;
+                    const auto element = list.substr(begin, end - begin);
+                    if (U("*") == element || strong_tag == details::strip_weakness_indicator(element)) return true;
+                }
+
+                first = last + 1;
+            }
+            return false;
+        }
+
         namespace cors
         {
             bool is_cors_response_header(const web::http::http_headers::key_type& header)
@@ -1,6 +1,13 @@
 #ifndef CPPREST_HTTP_UTILS_H
 #define CPPREST_HTTP_UTILS_H
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include "cpprest/http_msg.h"
 
 // Extensions to the HTTP request and reply message interfaces
@@ -17,6 +24,56 @@ namespace web
         void set_reply(web::http::http_response& res, web::http::status_code code, const utility::string_t& body_text, const utility::string_t& content_type = U("text/plain"));
         void set_reply(web::http::http_response& res, web::http::status_code code, const web::json::value& body_data);
 
+        // A fixed number of threads on which streamed response bodies are produced, so that slow or abandoned clients can tie up
+        // no more than that many threads, however many responses are being sent
+        // The pool should be stopped once the listeners using it have been closed
+        class streamed_reply_pool
+        {
+        public:
+            // the number of threads, and the number of response bodies which may wait for one
+            explicit streamed_reply_pool(std::size_t threads = 4, std::size_t max_queued = 64);
+            ~streamed_reply_pool();
+
+            // abandon the response bodies being produced, and those waiting, and join the threads
+            void stop();
+
+            // post a job to produce a response body, unless too many are already waiting, or the pool has been stopped
+            // the job is called with a flag that is set when the pool is stopped, which it should check while waiting
+            // (a job still waiting when the pool is stopped is called with the flag already set, so that it can clean up)
+            typedef std::function<void(const std::atomic<bool>& stopping)> job_type;
+            bool try_post(job_type job);
+
+        private:
+            // Non-copyable
+            streamed_reply_pool(const streamed_reply_pool&);
+            streamed_reply_pool& operator=(const streamed_reply_pool&);
+
+            void run();
+
+            std::mutex mutex;
+            std::condition_variable condition;
+            std::deque<job_type> jobs;
+            std::size_t max_queued;
+            std::atomic<bool> stopping;
+            std::vector<std::thread> threads;
+        };
+
+        // Set the response body to be written incrementally by the specified function, and sent with chunked transfer encoding
+        // as it is produced, rather than being built up in memory in its entirety before the response can be sent
+        // the function is called asynchronously, on one of the pool's threads, so must only refer to data that outlives the
+        // response; it blocks while more than a bounded amount of the body is waiting to be sent
+        // if all the pool's threads are busy and too many bodies are already waiting, the body is produced in memory instead
+        void set_streamed_reply(web::http::http_response& res, web::http::status_code code, std::function<void(utility::ostream_t&)> write_body, streamed_reply_pool& pool, const utility::string_t& content_type = U("application/octet-stream"));
+
+        // Conditional requests, see https://tools.ietf.org/html/rfc7232
+
+        // Make a strong entity-tag, i.e. a quoted string, from the specified opaque value, which must not contain '"'
+        utility::string_t make_entity_tag(const utility::string_t& opaque_tag);
+
+        // Determine whether the request has an If-None-Match header that matches the specified entity-tag, using the weak comparison
+        // function, in which case a GET request should get a 304 Not Modified response rather than the selected representation
+        bool match_if_none_match(const web::http::http_request& req, const utility::string_t& entity_tag);
+
         namespace cors
         {
             // Functions related to Cross-Origin Resource Sharing (CORS) headers
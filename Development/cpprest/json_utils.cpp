@@ -1,5 +1,7 @@
 #include "cpprest/json_utils.h"
 
+#include <algorithm>
+#include <vector>
 #include <boost/algorithm/string/find.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 
@@ -46,88 +48,117 @@ namespace web
         // if any arrays are encountered on the key path, results is an array, otherwise it's a non-array value
         bool extract(const web::json::object& object, web::json::value& results, const utility::string_t& key_path)
         {
-            bool match = false;
-            results = web::json::value::null();
+            return extract(object, results, split_key_path(key_path));
+        }
 
-            std::list<const web::json::object*> pobjects(1, &object);
+        // split a key path on '.', so that it can be reused for many extractions
+        std::vector<utility::string_t> split_key_path(const utility::string_t& key_path)
+        {
+            std::vector<utility::string_t> keys;
             utility::string_t::size_type key_first = 0;
             do
             {
                 const utility::string_t::size_type key_last = key_path.find_first_of(U("."), key_first);
-                const utility::string_t key = key_path.substr(key_first, details::count(key_first, key_last));
-                if (utility::string_t::npos != key_last)
+                keys.push_back(key_path.substr(key_first, details::count(key_first, key_last)));
+                key_first = utility::string_t::npos != key_last ? key_last + 1 : key_last;
+            } while (utility::string_t::npos != key_first);
+            return keys;
+        }
+
+        // find a value or values from an object, using an already split key path
+        bool extract(const web::json::object& object, web::json::value& results, const std::vector<utility::string_t>& key_path)
+        {
+            extracted_refs refs;
+            const bool match = extract(object, refs, key_path);
+            results = refs.value();
+            return match;
+        }
+
+        web::json::value extracted_refs::value() const
+        {
+            if (!arrays)
+            {
+                // field must be the only result(s)
+                // field may be any type of value though, including null or an array
+                return fields.empty() ? web::json::value::null() : *fields.front();
+            }
+
+            // merge arrays into results
+            web::json::value results = web::json::value::array();
+            for (auto field : fields)
+            {
+                if (field->is_array())
+                {
+                    for (auto& element : field->as_array())
+                    {
+                        web::json::push_back(results, element);
+                    }
+                }
+                else
+                {
+                    web::json::push_back(results, *field);
+                }
+            }
+            return results;
+        }
+
+        // find a value or values from an object, using an already split key path, without copying them
+        bool extract(const web::json::object& object, extracted_refs& results, const std::vector<utility::string_t>& key_path)
+        {
+            results.fields.clear();
+            results.arrays = false;
+
+            boost::container::small_vector<const web::json::object*, 4> pobjects(1, &object);
+            boost::container::small_vector<const web::json::object*, 4> next_pobjects;
+            for (auto key_it = key_path.begin(); key_path.end() != key_it; ++key_it)
+            {
+                const utility::string_t& key = *key_it;
+                if (key_path.end() != key_it + 1)
                 {
                     // not the leaf key, so map each object to the specified field, searching arrays and filtering out other types
-                    for (auto it = pobjects.begin(); pobjects.end() != it; it = pobjects.erase(it))
+                    next_pobjects.clear();
+                    for (auto pobject : pobjects)
                     {
-                        auto& object = **it;
-                        auto found = object.find(key);
-                        if (object.end() != found)
+                        auto found = pobject->find(key);
+                        if (pobject->end() != found)
                         {
                             auto& field = found->second;
                             if (field.is_array())
                             {
                                 // encountered an array
-                                if (!results.is_array())
-                                {
-                                    results = web::json::value::array();
-                                }
+                                results.arrays = true;
 
                                 for (auto& element : field.as_array())
                                 {
                                     if (element.is_object())
                                     {
-                                        pobjects.insert(it, &element.as_object());
+                                        next_pobjects.push_back(&element.as_object());
                                     }
                                 }
                             }
                             else if (field.is_object())
                             {
-                                pobjects.insert(it, &field.as_object());
+                                next_pobjects.push_back(&field.as_object());
                             }
                         }
                     }
+                    pobjects.swap(next_pobjects);
                 }
                 else
                 {
-                    // leaf key, so map each object to the specified field, merging arrays into results
-                    for (auto& pobject : pobjects)
+                    // leaf key, so map each object to the specified field
+                    for (auto pobject : pobjects)
                     {
-                        auto& object = *pobject;
-                        auto found = object.find(key);
-                        if (object.end() != found)
+                        auto found = pobject->find(key);
+                        if (pobject->end() != found)
                         {
-                            auto& field = found->second;
-                            if (!results.is_array())
-                            {
-                                // field must be the only result(s); i.e. match currently false
-                                // field may be any type of value though, including null or an array
-                                results = field;
-                            }
-                            else
-                            {
-                                if (field.is_array())
-                                {
-                                    for (auto& element : field.as_array())
-                                    {
-                                        web::json::push_back(results, element);
-                                    }
-                                }
-                                else
-                                {
-                                    web::json::push_back(results, field);
-                                }
-                            }
-
-                            // found a match!
-                            if (!match) match = true;
+                            results.fields.push_back(&found->second);
                         }
                     }
                 }
-                key_first = utility::string_t::npos != key_last ? key_last + 1 : key_last;
-            } while (utility::string_t::npos != key_first);
+            }
 
-            return match;
+            return !results.fields.empty();
         }
 
         // construct an ordered parameters object from a URI-encoded query string of '&' or ';' separated terms expected to be field=value pairs
@@ -227,5 +258,141 @@ namespace web
                 return false;
             }
         }
+
+        namespace details
+        {
+            // a node of a compiled query/exemplar
+            struct query_node
+            {
+                web::json::value::value_type type;
+
+                // for an object query, the field names and sub-queries
+                std::vector<std::pair<utility::string_t, std::shared_ptr<const query_node>>> fields;
+
+                // for a string query, the string, in lower case if case-insensitive matches are OK
+                utility::string_t string;
+                // and, if the string is valid json, its parsed form, for values of other types
+                std::shared_ptr<const query_node> parsed;
+
+                // for any other query, the value itself
+                web::json::value literal;
+            };
+
+            inline utility::string_t to_lower(utility::string_t s, const std::ctype<utility::char_t>& ctype)
+            {
+                ctype.tolower(&s[0], &s[0] + s.size());
+                return s;
+            }
+
+            std::shared_ptr<const query_node> compile_query(const web::json::value& query, match_flag_type match_flags, const std::ctype<utility::char_t>& ctype)
+            {
+                auto result = std::make_shared<query_node>();
+                result->type = query.type();
+                if (query.is_object())
+                {
+                    for (auto& query_field : query.as_object())
+                    {
+                        result->fields.push_back({ query_field.first, compile_query(query_field.second, match_flags, ctype) });
+                    }
+                }
+                else if (query.is_string())
+                {
+                    result->string = 0 != (match_icase & match_flags) ? to_lower(query.as_string(), ctype) : query.as_string();
+
+                    // last resort; treat the query string as serialized json...
+                    // (since a parsed string is always shorter than the serialized json, this terminates)
+                    std::error_code ec;
+                    const web::json::value parsed_query = web::json::value::parse(query.as_string(), ec);
+                    if (!ec) result->parsed = compile_query(parsed_query, match_flags, ctype);
+                }
+                else
+                {
+                    result->literal = query;
+                }
+                return result;
+            }
+
+            bool match_string(const utility::string_t& value, const utility::string_t& query, match_flag_type match_flags, const std::ctype<utility::char_t>& ctype)
+            {
+                if (0 != (match_icase & match_flags))
+                {
+                    // query is already lower case
+                    const auto iequal = [&ctype](utility::char_t v, utility::char_t q) { return ctype.tolower(v) == q; };
+                    return 0 != (match_substr & match_flags)
+                        ? value.end() != std::search(value.begin(), value.end(), query.begin(), query.end(), iequal)
+                        : value.size() == query.size() && std::equal(value.begin(), value.end(), query.begin(), iequal);
+                }
+                else
+                {
+                    return 0 != (match_substr & match_flags)
+                        ? utility::string_t::npos != value.find(query)
+                        : value == query;
+                }
+            }
+
+            // see match_query
+            bool match_compiled_query(const web::json::value& value, const query_node& query, match_flag_type match_flags, const std::ctype<utility::char_t>& ctype)
+            {
+                if (value.is_array())
+                {
+                    // one of the value's elements must match the query
+                    for (auto& element : value.as_array())
+                    {
+                        if (match_compiled_query(element, query, match_flags, ctype))
+                        {
+                            return true;
+                        }
+                    }
+                    return false;
+                }
+                else if (value.is_object() && web::json::value::Object == query.type)
+                {
+                    // value must have fields matching all of the query fields, but other value fields are ignored
+                    auto& object = value.as_object();
+                    for (auto& query_field : query.fields)
+                    {
+                        auto found = object.find(query_field.first);
+                        if (object.end() == found || !match_compiled_query(found->second, *query_field.second, match_flags, ctype))
+                        {
+                            return false;
+                        }
+                    }
+                    return true;
+                }
+                else if (value.type() == query.type)
+                {
+                    return web::json::value::String == query.type
+                        ? match_string(value.as_string(), query.string, match_flags, ctype)
+                        : value == query.literal;
+                }
+                else if (web::json::value::String == query.type)
+                {
+                    return query.parsed && match_compiled_query(value, *query.parsed, match_flags, ctype);
+                }
+                else
+                {
+                    return false;
+                }
+            }
+        }
+
+        query_matcher::query_matcher()
+            : ctype(&std::use_facet<std::ctype<utility::char_t>>(locale))
+            , root(details::compile_query(web::json::value::object(), match_default, *ctype))
+            , match_flags(match_default)
+        {
+        }
+
+        query_matcher::query_matcher(const web::json::value& query, match_flag_type match_flags)
+            : ctype(&std::use_facet<std::ctype<utility::char_t>>(locale))
+            , root(details::compile_query(query, match_flags, *ctype))
+            , match_flags(match_flags)
+        {
+        }
+
+        bool query_matcher::operator()(const web::json::value& value) const
+        {
+            return details::match_compiled_query(value, *root, match_flags, *ctype);
+        }
     }
 }
@@ -1,6 +1,10 @@
 #ifndef CPPREST_JSON_UTILS_H
 #define CPPREST_JSON_UTILS_H
 
+#include <locale>
+#include <memory>
+#include <vector>
+#include <boost/container/small_vector.hpp>
 #include "cpprest/json.h"
 #include "cpprest/base_uri.h" // for web::uri::decode
 
@@ -223,6 +227,13 @@ namespace web
             return os.str();
         }
 
+        template <typename ForwardRange, typename Transform>
+        inline void serialize(utility::ostream_t& os, const ForwardRange& range, Transform transform)
+        {
+            using std::begin;
+            serialize_if(os, range, [](const typename std::iterator_traits<decltype(begin(range))>::value_type& element) { return true; }, transform);
+        }
+
         template <typename ForwardRange, typename Transform>
         inline utility::string_t serialize(const ForwardRange& range, Transform transform)
         {
@@ -256,6 +267,32 @@ namespace web
         // if any arrays are encountered on the key path, results is an array, otherwise it's a non-array value
         bool extract(const web::json::object& object, web::json::value& results, const utility::string_t& key_path);
 
+        // split a key path on '.', so that it can be reused for many extractions
+        std::vector<utility::string_t> split_key_path(const utility::string_t& key_path);
+
+        // find a value or values from an object, using an already split key path
+        bool extract(const web::json::object& object, web::json::value& results, const std::vector<utility::string_t>& key_path);
+
+        // the value or values found in an object by extract, referred to rather than copied, so only valid as long as the object
+        struct extracted_refs
+        {
+            extracted_refs() : arrays(false) {}
+
+            // the matching fields
+            boost::container::small_vector<const web::json::value*, 4> fields;
+
+            // whether any arrays were encountered on the key path, in which case the equivalent extracted value would be
+            // an array of the matching fields (with any array fields merged), otherwise it's the only matching field, or null
+            bool arrays;
+
+            // the equivalent extracted value (a copy)
+            web::json::value value() const;
+        };
+
+        // find a value or values from an object, using an already split key path, without copying them
+        // returns true if the object matches the key path
+        bool extract(const web::json::object& object, extracted_refs& results, const std::vector<utility::string_t>& key_path);
+
         // match_flag_type is a bitmask
         enum match_flag_type
         {
@@ -276,6 +313,30 @@ namespace web
 
         // compare a value against a query/exemplar
         bool match_query(const web::json::value& value, const web::json::value& query, match_flag_type match_flags = match_default);
+
+        namespace details
+        {
+            struct query_node;
+        }
+
+        // a query/exemplar compiled for comparing against many values, with the same result as match_query but without
+        // re-interpreting the query for every value, i.e. with field names, lower-case strings for case-insensitive matches
+        // and the parsed form of query strings used to match values of other types all worked out up front
+        class query_matcher
+        {
+        public:
+            // the default query/exemplar is an empty object, which matches any object
+            query_matcher();
+            explicit query_matcher(const web::json::value& query, match_flag_type match_flags = match_default);
+
+            bool operator()(const web::json::value& value) const;
+
+        private:
+            std::locale locale;
+            const std::ctype<utility::char_t>* ctype;
+            std::shared_ptr<const details::query_node> root;
+            match_flag_type match_flags;
+        };
     }
 }
 
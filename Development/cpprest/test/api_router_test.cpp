@@ -1,6 +1,8 @@
 // The first "test" is of course whether the header compiles standalone
 #include "cpprest/api_router.h"
 
+#include <chrono>
+#include <vector>
 #include "bst/test/test.h"
 #include "cpprest/basic_utils.h" // for utility::us2s, utility::s2us
 
@@ -80,3 +82,117 @@ BST_TEST_CASE_PRIVATE(testGetParameters)
     BST_REQUIRE(std::regex_match(path, route_match, route_regex));
     BST_REQUIRE(expected == api_router::get_parameters(parameter_sub_matches, route_match));
 }
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE_PRIVATE(testGetRoutePrefix)
+{
+    using utility::us2s;
+    using web::http::experimental::listener::api_router;
+
+    BST_REQUIRE_STRING_EQUAL("/foo/bar", us2s(api_router::get_route_prefix(U("/foo/bar"))));
+    BST_REQUIRE_STRING_EQUAL("/x-nmos/", us2s(api_router::get_route_prefix(U("/x-nmos/(query)/(v1\\.[0-2])/?"))));
+    BST_REQUIRE_STRING_EQUAL("/nodes", us2s(api_router::get_route_prefix(U("/nodes/?"))));
+    BST_REQUIRE_STRING_EQUAL("", us2s(api_router::get_route_prefix(U("/?"))));
+    BST_REQUIRE_STRING_EQUAL("/fo", us2s(api_router::get_route_prefix(U("/fo\\.o"))));
+    BST_REQUIRE_STRING_EQUAL("/", us2s(api_router::get_route_prefix(U("/(foo|bar)/baz"))));
+    BST_REQUIRE_STRING_EQUAL("", us2s(api_router::get_route_prefix(U("/foo|/bar"))));
+    BST_REQUIRE_STRING_EQUAL("/", us2s(api_router::get_route_prefix(U("/[|]/baz"))));
+
+    BST_REQUIRE(api_router::route_prefix_match(U("/x-nmos/query/v1.2/nodes"), U("/x-nmos/")));
+    BST_REQUIRE(api_router::route_prefix_match(U("/x-nmos/"), U("/x-nmos/")));
+    BST_REQUIRE(api_router::route_prefix_match(U("/x-nmos/"), U("")));
+    BST_REQUIRE(!api_router::route_prefix_match(U("/x-nmos"), U("/x-nmos/")));
+    BST_REQUIRE(!api_router::route_prefix_match(U("/log/events"), U("/x-nmos/")));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_BENCHMARK_CASE_PRIVATE(testRouteDispatchBenchmark)
+{
+    using namespace web::http::experimental::listener::api_router_using_declarations;
+    using web::http::experimental::listener::api_router;
+
+    // the Query API route set, written out in full, and flattened into a single router
+    // (in the real thing, the version-specific routes are mounted, so the paths below include both absolute and mount-relative paths)
+    const string_t version{ U("(?<version>v1\\.[0-2])") };
+    const string_t resourceType{ U("(?<resourceType>nodes|devices|sources|flows|senders|receivers|subscriptions)") };
+    const string_t resourceId{ U("(?<resourceId>[0-9a-f]{8}-[0-9a-f]{4}-[1-5][0-9a-f]{3}-[89ab][0-9a-f]{3}-[0-9a-f]{12})") };
+    const std::vector<std::pair<api_router::match_flag_type, string_t>> route_patterns
+    {
+        { api_router::match_entire, U("/?") },
+        { api_router::match_entire, U("/x-nmos/?") },
+        { api_router::match_entire, U("/x-nmos/(?<api>query)/?") },
+        { api_router::match_prefix, U("/x-nmos/(?<api>query)/") + version },
+        { api_router::match_entire, U("/?") },
+        { api_router::match_entire, U("/") + resourceType + U("/?") },
+        { api_router::match_entire, U("/") + resourceType + U("/") + resourceId + U("/?") },
+        { api_router::match_entire, U("/subscriptions/?") },
+        { api_router::match_entire, U("/subscriptions/") + resourceId + U("/?") }
+    };
+    const std::vector<string_t> paths
+    {
+        U("/x-nmos/query/v1.2/nodes/"),
+        U("/x-nmos/query/v1.2/senders/3b8be755-08ff-452b-b217-c9151eb21193"),
+        U("/x-nmos/query/v1.1/subscriptions/"),
+        U("/x-nmos/query/"),
+        U("/nodes/"),
+        U("/senders/3b8be755-08ff-452b-b217-c9151eb21193"),
+        U("/subscriptions/"),
+        U("/log/events")
+    };
+    const int iterations = 100;
+
+    api_router router;
+    size_t compiled_matches = 0;
+    for (auto& route_pattern : route_patterns)
+    {
+        router.insert(router.routes.end(), route_pattern.first, route_pattern.second, methods::GET, [&compiled_matches](const http_request&, http_response&, const string_t&, const route_parameters&)
+        {
+            ++compiled_matches;
+            return true;
+        });
+    }
+
+    // per-request regex construction, as in the original dispatch
+    size_t constructed_matches = 0;
+    const auto constructed_start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i)
+    {
+        for (auto& path : paths)
+        {
+            for (auto& route_pattern : route_patterns)
+            {
+                const auto regex_named_sub_matches = utility::parse_regex_named_sub_matches(route_pattern.second);
+                utility::smatch_t route_match;
+                if (api_router::route_regex_match(path, route_match, utility::regex_t(regex_named_sub_matches.first), route_pattern.first)) ++constructed_matches;
+            }
+        }
+    }
+    const auto constructed_duration = std::chrono::steady_clock::now() - constructed_start;
+
+    // compiled dispatch, by way of the router itself (constructing the requests up front, so only dispatch is timed)
+    std::vector<http_request> requests;
+    for (auto& path : paths)
+    {
+        requests.push_back(http_request());
+        requests.back().set_request_uri(web::uri(path));
+    }
+    const auto compiled_start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i)
+    {
+        for (auto& req : requests)
+        {
+            http_response res;
+            router(req, res, {}, {});
+        }
+    }
+    const auto compiled_duration = std::chrono::steady_clock::now() - compiled_start;
+
+    // both must agree on the routes that match
+    BST_REQUIRE_EQUAL(constructed_matches, compiled_matches);
+
+    // dispatch cost per request, over the whole route set
+    const auto dispatches = iterations * paths.size();
+    BST_MESSAGE("Query API route set (" << route_patterns.size() << " routes), dispatch per request: "
+        << std::chrono::duration_cast<std::chrono::microseconds>(constructed_duration).count() / dispatches << "us with per-request regex construction, "
+        << std::chrono::duration_cast<std::chrono::nanoseconds>(compiled_duration).count() / dispatches << "ns compiled");
+}
@@ -1,6 +1,8 @@
 // The first "test" is of course whether the header compiles standalone
 #include "cpprest/http_utils.h"
 
+#include <stdexcept>
+#include "cpprest/containerstream.h"
 #include "bst/test/test.h"
 
 ////////////////////////////////////////////////////////////////////////////////////////////
@@ -54,3 +56,117 @@ BST_TEST_CASE(testGetHostPort)
         BST_REQUIRE_EQUAL(std::make_pair(utility::string_t{ U("foobar") }, 0), web::http::get_host_port(req));
     }
 }
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testSetStreamedReply)
+{
+    web::http::streamed_reply_pool pool(1, 1);
+
+    // a body much larger than the bounded buffer, so the producer has to wait for it to be consumed
+    {
+        web::http::http_response res;
+        web::http::set_streamed_reply(res, web::http::status_codes::OK, [](utility::ostream_t& os)
+        {
+            for (int i = 0; i < 100000; ++i)
+            {
+                os << U("0123456789");
+            }
+        }, pool, U("text/plain"));
+
+        BST_REQUIRE_EQUAL(web::http::status_codes::OK, res.status_code());
+        BST_REQUIRE(U("text/plain") == res.headers().content_type());
+        BST_REQUIRE(!res.headers().has(web::http::header_names::content_length));
+
+        concurrency::streams::container_buffer<std::string> body;
+        res.body().read_to_end(body).wait();
+        BST_REQUIRE_EQUAL(1000000, body.collection().size());
+        BST_REQUIRE_STRING_EQUAL("0123456789", body.collection().substr(999990));
+    }
+    // an exception while producing the body is reported to the consumer, rather than the body appearing complete
+    {
+        web::http::http_response res;
+        web::http::set_streamed_reply(res, web::http::status_codes::OK, [](utility::ostream_t& os)
+        {
+            os << U("[");
+            throw std::runtime_error("oops");
+        }, pool);
+
+        concurrency::streams::container_buffer<std::string> body;
+        BST_REQUIRE_THROW(res.body().read_to_end(body).wait(), std::runtime_error);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testSetStreamedReplyPoolBusy)
+{
+    // when no more bodies can be queued, the body is produced immediately, and sent with a content length
+    {
+        web::http::streamed_reply_pool pool(0, 0);
+
+        web::http::http_response res;
+        web::http::set_streamed_reply(res, web::http::status_codes::OK, [](utility::ostream_t& os)
+        {
+            os << U("0123456789");
+        }, pool, U("text/plain"));
+
+        BST_REQUIRE_EQUAL(web::http::status_codes::OK, res.status_code());
+        BST_REQUIRE(U("text/plain") == res.headers().content_type());
+        BST_REQUIRE(res.headers().has(web::http::header_names::content_length));
+
+        concurrency::streams::container_buffer<std::string> body;
+        res.body().read_to_end(body).wait();
+        BST_REQUIRE_STRING_EQUAL("0123456789", body.collection());
+    }
+    // a body which is still queued when the pool is stopped is abandoned, rather than appearing complete
+    {
+        web::http::streamed_reply_pool pool(0, 1);
+
+        bool written = false;
+        web::http::http_response res;
+        web::http::set_streamed_reply(res, web::http::status_codes::OK, [&written](utility::ostream_t& os)
+        {
+            written = true;
+            os << U("0123456789");
+        }, pool);
+        BST_REQUIRE(!res.headers().has(web::http::header_names::content_length));
+
+        pool.stop();
+        BST_REQUIRE(!written);
+
+        concurrency::streams::container_buffer<std::string> body;
+        BST_REQUIRE_THROW(res.body().read_to_end(body).wait(), std::runtime_error);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testMatchIfNoneMatch)
+{
+    const auto entity_tag = web::http::make_entity_tag(U("1234:5678-42-abcdef"));
+    BST_REQUIRE(U("\"1234:5678-42-abcdef\"") == entity_tag);
+
+    // no 'If-None-Match' header
+    {
+        web::http::http_request req;
+        BST_REQUIRE(!web::http::match_if_none_match(req, entity_tag));
+    }
+    // exact match, any match, weak match
+    for (const auto& field : { U("\"1234:5678-42-abcdef\""), U("*"), U("W/\"1234:5678-42-abcdef\"") })
+    {
+        web::http::http_request req;
+        req.headers().add(web::http::header_names::if_none_match, utility::string_t(field));
+        BST_REQUIRE(web::http::match_if_none_match(req, entity_tag));
+    }
+    // match in a list, with optional whitespace
+    {
+        web::http::http_request req;
+        req.headers().add(web::http::header_names::if_none_match, U("\"foo\" ,\t\"1234:5678-42-abcdef\" , \"bar\""));
+        BST_REQUIRE(web::http::match_if_none_match(req, entity_tag));
+    }
+    // no match
+    for (const auto& field : { U(""), U(","), U("\"foo\", \"bar\""), U("\"1234:5678-42-abcde\""), U("1234:5678-42-abcdef") })
+    {
+        web::http::http_request req;
+        req.headers().add(web::http::header_names::if_none_match, utility::string_t(field));
+        BST_REQUIRE(!web::http::match_if_none_match(req, entity_tag));
+    }
+}
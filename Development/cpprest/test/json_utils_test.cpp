@@ -0,0 +1,108 @@
+// The first "test" is of course whether the header compiles standalone
+#include "cpprest/json_utils.h"
+
+#include "bst/test/test.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testQueryMatcher)
+{
+    const auto value = web::json::value::parse(U("{\"label\":\"Foo Bar\",\"version\":\"1:2\",\"count\":42,\"enabled\":true,\"tags\":[\"baz\",\"qux\"],\"caps\":{\"media_types\":[\"video/raw\",\"video/smpte291\"]},\"interfaces\":[{\"name\":\"eth0\"},{\"name\":\"eth1\"}]}"));
+
+    const web::json::match_flag_type all_flags[] = { web::json::match_default, web::json::match_substr, web::json::match_icase, web::json::match_substr | web::json::match_icase };
+
+    // the compiled query must give the same result as match_query, whatever the query and flags
+    const utility::char_t* queries[] =
+    {
+        U("{}"),
+        U("{\"label\":\"Foo Bar\"}"),
+        U("{\"label\":\"foo bar\"}"),
+        U("{\"label\":\"Foo\"}"),
+        U("{\"label\":\"oo b\"}"),
+        U("{\"label\":\"\"}"),
+        U("{\"count\":\"42\"}"),
+        U("{\"count\":\"43\"}"),
+        U("{\"count\":42}"),
+        U("{\"enabled\":\"true\"}"),
+        U("{\"enabled\":\"false\"}"),
+        U("{\"tags\":\"qux\"}"),
+        U("{\"tags\":\"QU\"}"),
+        U("{\"caps\":{\"media_types\":\"video/raw\"}}"),
+        U("{\"caps\":{\"media_types\":\"VIDEO\"}}"),
+        U("{\"caps\":\"{\\\"media_types\\\":\\\"video/raw\\\"}\"}"),
+        U("{\"interfaces\":{\"name\":\"eth1\"}}"),
+        U("{\"interfaces\":{\"name\":\"eth2\"}}"),
+        U("{\"label\":\"Foo Bar\",\"count\":\"42\"}"),
+        U("{\"label\":\"Foo Bar\",\"count\":\"43\"}"),
+        U("{\"missing\":\"\"}"),
+        U("{\"label\":{}}")
+    };
+
+    for (auto query_text : queries)
+    {
+        const auto query = web::json::value::parse(query_text);
+        for (auto match_flags : all_flags)
+        {
+            const web::json::query_matcher matcher(query, match_flags);
+            BST_REQUIRE_EQUAL(web::json::match_query(value, query, match_flags), matcher(value));
+        }
+    }
+
+    // some explicit expectations too
+    BST_REQUIRE(web::json::query_matcher()(value));
+    BST_REQUIRE(!web::json::query_matcher()(web::json::value::string(U("foo"))));
+    BST_REQUIRE(web::json::query_matcher(web::json::value::parse(U("{\"count\":\"42\"}")))(value));
+    BST_REQUIRE(!web::json::query_matcher(web::json::value::parse(U("{\"label\":\"foo bar\"}")))(value));
+    BST_REQUIRE(web::json::query_matcher(web::json::value::parse(U("{\"label\":\"foo bar\"}")), web::json::match_icase)(value));
+    BST_REQUIRE(web::json::query_matcher(web::json::value::parse(U("{\"label\":\"O B\"}")), web::json::match_icase | web::json::match_substr)(value));
+    BST_REQUIRE(web::json::query_matcher(web::json::value::parse(U("{\"interfaces\":{\"name\":\"eth1\"}}")))(value));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testExtractRefs)
+{
+    const auto value = web::json::value::parse(U("{\"label\":\"foo\",\"nothing\":null,\"tags\":[\"baz\",\"qux\"],\"caps\":{\"media_types\":[\"video/raw\"]},\"interfaces\":[{\"name\":\"eth0\",\"ips\":[\"1.2.3.4\",\"5.6.7.8\"]},{\"name\":\"eth1\",\"ips\":\"9.10.11.12\"},{\"nope\":42},\"bar\"]}"));
+    const auto& object = value.as_object();
+
+    // the referred values must be equivalent to the extracted copies
+    const utility::char_t* key_paths[] =
+    {
+        U("label"),
+        U("nothing"),
+        U("tags"),
+        U("caps.media_types"),
+        U("interfaces.name"),
+        U("interfaces.ips"),
+        U("interfaces.nope"),
+        U("interfaces.missing"),
+        U("label.missing"),
+        U("missing")
+    };
+
+    for (auto key_path : key_paths)
+    {
+        web::json::value results;
+        const bool match = web::json::extract(object, results, key_path);
+
+        web::json::extracted_refs refs;
+        BST_REQUIRE_EQUAL(match, web::json::extract(object, refs, web::json::split_key_path(key_path)));
+        BST_REQUIRE_EQUAL(results, refs.value());
+    }
+
+    // no copies are made
+    {
+        web::json::extracted_refs refs;
+        BST_REQUIRE(web::json::extract(object, refs, web::json::split_key_path(U("caps.media_types"))));
+        BST_REQUIRE(!refs.arrays);
+        BST_REQUIRE_EQUAL(1, refs.fields.size());
+        BST_REQUIRE_EQUAL(&value.at(U("caps")).at(U("media_types")), refs.fields.front());
+    }
+    {
+        web::json::extracted_refs refs;
+        BST_REQUIRE(web::json::extract(object, refs, web::json::split_key_path(U("interfaces.ips"))));
+        BST_REQUIRE(refs.arrays);
+        BST_REQUIRE_EQUAL(2, refs.fields.size());
+        BST_REQUIRE_EQUAL(&value.at(U("interfaces")).at(0).at(U("ips")), refs.fields[0]);
+        BST_REQUIRE_EQUAL(&value.at(U("interfaces")).at(1).at(U("ips")), refs.fields[1]);
+        BST_REQUIRE_EQUAL(3, refs.value().size());
+    }
+}
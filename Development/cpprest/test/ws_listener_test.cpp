@@ -0,0 +1,131 @@
+// The first "test" is of course whether the header compiles standalone
+#include "cpprest/ws_listener.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "cpprest/basic_utils.h"
+#include "cpprest/ws_client.h"
+#include "bst/test/test.h"
+
+namespace
+{
+    pplx::task<void> receive_messages(web::websockets::client::websocket_client& client, size_t count, std::atomic<size_t>& received)
+    {
+        if (0 == count) return pplx::task_from_result();
+        return client.receive().then([&client, count, &received](web::websockets::client::websocket_incoming_message message)
+        {
+            return message.extract_string().then([&client, count, &received](std::string)
+            {
+                ++received;
+                return receive_messages(client, count - 1, received);
+            });
+        });
+    }
+
+    struct ws_listener_benchmark_result
+    {
+        std::chrono::steady_clock::duration handshakes;
+        std::chrono::steady_clock::duration sends;
+    };
+
+    // connect the specified number of clients, then send the specified number of messages to all of them
+    ws_listener_benchmark_result run_ws_listener_benchmark(int port, int thread_count, size_t client_count, size_t message_count)
+    {
+        using namespace web::websockets;
+
+        experimental::listener::websocket_listener listener(port, {}, thread_count);
+
+        std::mutex mutex;
+        std::vector<experimental::listener::connection_id> connections;
+        listener.set_open_handler([&](const utility::string_t&, const experimental::listener::connection_id& connection)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            connections.push_back(connection);
+        });
+        listener.open().wait();
+
+        const web::uri uri(U("ws://localhost:") + utility::ostringstreamed(port) + U("/"));
+
+        std::vector<std::unique_ptr<client::websocket_client>> clients;
+        std::vector<pplx::task<void>> connects;
+
+        const auto handshakes_start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < client_count; ++i)
+        {
+            clients.push_back(std::unique_ptr<client::websocket_client>(new client::websocket_client));
+            connects.push_back(clients.back()->connect(uri));
+        }
+        pplx::when_all(connects.begin(), connects.end()).wait();
+        // the open handler may not yet have been called for the last few connections
+        for (;;)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (client_count <= connections.size()) break;
+            }
+            std::this_thread::yield();
+        }
+        const auto handshakes_duration = std::chrono::steady_clock::now() - handshakes_start;
+
+        const std::string payload(4096, 'x');
+
+        std::atomic<size_t> received(0);
+        std::vector<pplx::task<void>> receives;
+        for (auto& client : clients)
+        {
+            receives.push_back(receive_messages(*client, message_count, received));
+        }
+
+        const auto sends_start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < message_count; ++i)
+        {
+            experimental::listener::websocket_outgoing_message message;
+            message.set_utf8_message(payload);
+            listener.send(connections, message).wait();
+        }
+        pplx::when_all(receives.begin(), receives.end()).wait();
+        const auto sends_duration = std::chrono::steady_clock::now() - sends_start;
+
+        BST_REQUIRE_EQUAL(client_count * message_count, received.load());
+
+        for (auto& client : clients)
+        {
+            client->close().wait();
+        }
+        listener.close().wait();
+
+        return{ handshakes_duration, sends_duration };
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testWsListenerThreads)
+{
+    // every client receives every message, with more than one io thread
+    run_ws_listener_benchmark(49800, 2, 10, 5);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_BENCHMARK_CASE(testWsListenerThreadsBenchmark)
+{
+    // compare handshake rate and send throughput for 200 clients with 1, 2 and 4 io threads
+    const size_t client_count = 200;
+    const size_t message_count = 50;
+
+    int port = 49810;
+    for (int thread_count : { 1, 2, 4 })
+    {
+        // use a different port each time to avoid any delay in reusing the address
+        const auto result = run_ws_listener_benchmark(port++, thread_count, client_count, message_count);
+
+        // more io threads should help, given enough cores
+        const auto handshakes_seconds = std::chrono::duration_cast<std::chrono::duration<double>>(result.handshakes).count();
+        const auto sends_seconds = std::chrono::duration_cast<std::chrono::duration<double>>(result.sends).count();
+        BST_MESSAGE(thread_count << " io thread(s), " << client_count << " clients: "
+            << client_count / handshakes_seconds << " handshakes/s, "
+            << client_count * message_count / sends_seconds << " messages/s");
+    }
+}
@@ -3,6 +3,7 @@
 
 #include <functional>
 #include <memory>
+#include <vector>
 
 #include "pplx/pplxtasks.h"
 #include "cpprest/logging_utils.h"
@@ -58,7 +59,9 @@ namespace web
                 class websocket_listener
                 {
                 public:
-                    explicit websocket_listener(int port = 80, web::logging::experimental::callback_function log = {});
+                    // the listener's io is serviced by the specified number of threads; each connection's handlers are serialized
+                    // (websocketpp uses a strand per connection) but different connections may be handled concurrently
+                    explicit websocket_listener(int port = 80, web::logging::experimental::callback_function log = {}, int thread_count = 1);
                     ~websocket_listener();
 
                     void set_validate_handler(validate_handler handler);
@@ -69,6 +72,9 @@ namespace web
                     pplx::task<void> close();
 
                     pplx::task<void> send(const connection_id& connection, websocket_outgoing_message message);
+                    // send the same message on multiple connections, framing it only once
+                    // the task completes with an exception if sending failed on any of the connections (e.g. because it was already closed)
+                    pplx::task<void> send(const std::vector<connection_id>& connections, websocket_outgoing_message message);
                     //pplx::task<websocket_incoming_message> receive(const connection_id& connection);
                     //or void set_message_handler(const connection_id& connection, message_handler handler);
 
@@ -81,6 +87,7 @@ namespace web
 
                     std::unique_ptr<details::websocket_listener_impl> impl;
                     int port;
+                    int thread_count;
                 };
             }
         }
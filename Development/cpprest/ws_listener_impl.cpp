@@ -1,7 +1,10 @@
 #include "cpprest/ws_listener.h"
 
+#include <algorithm>
 #include <mutex>
 #include <set>
+#include <thread>
+#include <vector>
 #include "detail/pragma_warnings.h"
 #include "detail/private_access.h"
 
@@ -198,12 +201,15 @@ namespace web
                             user_close = handler;
                         }
 
-                        pplx::task<void> open(int port)
+                        pplx::task<void> open(int port, int thread_count)
                         {
                             server.init_asio();
                             server.start_perpetual();
-                            // hmm, is one thread enough?
-                            thread = std::thread(&server_t::run, &server);
+                            // one thread is enough for a few connections, but handshakes and sends for thousands of them benefit from more
+                            for (int i = 0; i < (std::max)(thread_count, 1); ++i)
+                            {
+                                threads.push_back(std::thread(&server_t::run, &server));
+                            }
 
                             using websocketpp::lib::bind;
                             using websocketpp::lib::placeholders::_1;
@@ -232,10 +238,14 @@ namespace web
                             }
 
                             server.stop_perpetual();
-                            if (thread.joinable())
+                            for (auto& thread : threads)
                             {
-                                thread.join();
+                                if (thread.joinable())
+                                {
+                                    thread.join();
+                                }
                             }
+                            threads.clear();
 
                             return pplx::task_from_result();
                         }
@@ -269,6 +279,49 @@ namespace web
                             return pplx::task_from_result();
                         }
 
+                        pplx::task<void> send(const std::vector<connection_id>& connections, websocket_outgoing_message message)
+                        {
+                            auto body = get_message_body(message);
+                            uint8_t* ptr = nullptr;
+                            size_t count = 0;
+                            bool acquired = body.acquire(ptr, count);
+                            if (!acquired || nullptr == ptr || 0 == count)
+                            {
+                                return pplx::task_from_exception<void>(websocket_exception("Invalid message body"));
+                            }
+
+                            // a server's frames are unmasked, so the message can be framed once, as a websocketpp prepared message,
+                            // and then the same reference-counted frame is queued on each connection
+                            // (this assumes every connection uses the RFC 6455 protocol, which is all that current clients support)
+                            auto manager = websocketpp::lib::make_shared<websocketpp_config::con_msg_manager_type>();
+                            auto payload = manager->get_message(websocketpp::frame::opcode::text, count);
+                            payload->append_payload(ptr, count);
+                            body.release(ptr, count);
+
+                            auto prepared = manager->get_message();
+                            websocketpp_config::rng_type rng;
+                            websocketpp::processor::hybi13<websocketpp_config> processor(false, true, manager, rng);
+                            auto ec = processor.prepare_data_frame(payload, prepared);
+                            if (ec)
+                            {
+                                return pplx::task_from_exception<void>(websocket_exception(ec, build_error_msg(ec, "send")));
+                            }
+
+                            // carry on sending to the other connections even if one fails
+                            websocketpp::lib::error_code first_ec;
+                            for (const auto& connection : connections)
+                            {
+                                server.send(hdl_from_id(connection), prepared, ec);
+                                if (ec && !first_ec) first_ec = ec;
+                            }
+
+                            if (first_ec)
+                            {
+                                return pplx::task_from_exception<void>(websocket_exception(first_ec, build_error_msg(first_ec, "send")));
+                            }
+                            return pplx::task_from_result();
+                        }
+
                     private:
                         typedef websocketpp::server<websocketpp_config> server_t;
                         typedef std::set<websocketpp::connection_hdl, std::owner_less<websocketpp::connection_hdl>> connections_t;
@@ -319,7 +372,7 @@ namespace web
                             }
                         }
 
-                        std::thread thread;
+                        std::vector<std::thread> threads;
                         server_t server;
                         connections_t connections;
                         std::mutex mutex;
@@ -330,15 +383,17 @@ namespace web
                     };
                 }
 
-                websocket_listener::websocket_listener(int port, web::logging::experimental::callback_function log)
+                websocket_listener::websocket_listener(int port, web::logging::experimental::callback_function log, int thread_count)
                     : impl(std::make_unique<details::websocket_listener_impl>(log))
                     , port(port)
+                    , thread_count(thread_count)
                 {
                 }
 
                 websocket_listener::websocket_listener(websocket_listener&& other)
                     : impl(std::move(other.impl))
                     , port(other.port)
+                    , thread_count(other.thread_count)
                 {
                 }
 
@@ -348,6 +403,7 @@ namespace web
                     {
                         impl = std::move(other.impl);
                         port = other.port;
+                        thread_count = other.thread_count;
                     }
                     return *this;
                 }
@@ -373,7 +429,7 @@ namespace web
 
                 pplx::task<void> websocket_listener::open()
                 {
-                    return impl->open(port);
+                    return impl->open(port, thread_count);
                 }
 
                 pplx::task<void> websocket_listener::close()
@@ -385,6 +441,11 @@ namespace web
                 {
                     return impl->send(connection, message);
                 }
+
+                pplx::task<void> websocket_listener::send(const std::vector<connection_id>& connections, websocket_outgoing_message message)
+                {
+                    return impl->send(connections, message);
+                }
             }
         }
     }
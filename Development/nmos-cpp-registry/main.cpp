@@ -1,4 +1,5 @@
 #include "cpprest/host_utils.h"
+#include "cpprest/http_utils.h" // for web::http::streamed_reply_pool
 #include "cpprest/ws_listener.h"
 #include "nmos/api_utils.h"
 #include "nmos/admin_ui.h"
@@ -26,6 +27,7 @@ int main(int argc, char* argv[])
     std::mutex nmos_mutex;
 
     nmos::experimental::log_model log_model;
+    // the logging gateway writes to stdout and the log model while holding log_mutex, so nothing must be logged while holding it
     std::mutex log_mutex;
     std::atomic<slog::severity> level = slog::severities::more_info;
 
@@ -74,6 +76,12 @@ int main(int argc, char* argv[])
         nmos_model.settings[nmos::fields::host_address] = web::json::value::string(web::http::experimental::host_addresses(web::http::experimental::host_name())[0]);
     }
 
+    gate.set_overflow_policy(nmos::experimental::parse_overflow_policy(nmos::experimental::fields::logging_overflow_policy(nmos_model.settings)));
+    {
+        std::lock_guard<std::mutex> lock(log_mutex);
+        log_model.events.set_capacity((std::size_t)(std::max)(nmos::experimental::fields::logging_events_capacity(nmos_model.settings), 1));
+    }
+
     // Configure the mDNS API
 
     web::http::experimental::listener::api_router mdns_api = nmos::experimental::make_mdns_api(nmos_mutex, level, gate);
@@ -86,31 +94,36 @@ int main(int argc, char* argv[])
     web::http::experimental::listener::http_listener settings_listener(web::http::experimental::listener::make_listener_uri(nmos::experimental::fields::settings_port(nmos_model.settings)));
     nmos::support_api(settings_listener, settings_api);
 
+    // Large responses from the Logging, Query and Node APIs are streamed, produced on a few threads shared between them
+
+    web::http::streamed_reply_pool streamed_replies;
+
     // Configure the Logging API
 
-    web::http::experimental::listener::api_router logging_api = nmos::experimental::make_logging_api(log_model, log_mutex, gate);
+    web::http::experimental::listener::api_router logging_api = nmos::experimental::make_logging_api(log_model, log_mutex, streamed_replies, gate);
     web::http::experimental::listener::http_listener logging_listener(web::http::experimental::listener::make_listener_uri(nmos::experimental::fields::logging_port(nmos_model.settings)));
     nmos::support_api(logging_listener, logging_api);
 
     // Configure the Query API
 
-    web::http::experimental::listener::api_router query_api = nmos::make_query_api(nmos_model, nmos_mutex, gate);
+    web::http::experimental::listener::api_router query_api = nmos::make_query_api(nmos_model, nmos_mutex, streamed_replies, gate);
     web::http::experimental::listener::http_listener query_listener(web::http::experimental::listener::make_listener_uri(nmos::fields::query_port(nmos_model.settings)));
     nmos::support_api(query_listener, query_api);
 
     nmos::websockets nmos_websockets;
+    nmos::websocket_events_schedule nmos_websocket_events_schedule; // associated with nmos_mutex
 
     std::condition_variable query_ws_events_condition; // associated with nmos_mutex
 
     web::websockets::experimental::listener::validate_handler query_ws_validate_handler = nmos::make_query_ws_validate_handler(nmos_model, nmos_mutex, gate);
-    web::websockets::experimental::listener::open_handler query_ws_open_handler = nmos::make_query_ws_open_handler(nmos_model, nmos_websockets, nmos_mutex, query_ws_events_condition, gate);
+    web::websockets::experimental::listener::open_handler query_ws_open_handler = nmos::make_query_ws_open_handler(nmos_model, nmos_websockets, nmos_websocket_events_schedule, nmos_mutex, query_ws_events_condition, gate);
     web::websockets::experimental::listener::close_handler query_ws_close_handler = nmos::make_query_ws_close_handler(nmos_model, nmos_websockets, nmos_mutex, gate);
-    web::websockets::experimental::listener::websocket_listener query_ws_listener(nmos::fields::query_ws_port(nmos_model.settings), nmos::make_slog_logging_callback(gate));
+    web::websockets::experimental::listener::websocket_listener query_ws_listener(nmos::fields::query_ws_port(nmos_model.settings), nmos::make_slog_logging_callback(gate), nmos::fields::query_ws_threads(nmos_model.settings));
     query_ws_listener.set_validate_handler(std::ref(query_ws_validate_handler));
     query_ws_listener.set_open_handler(std::ref(query_ws_open_handler));
     query_ws_listener.set_close_handler(std::ref(query_ws_close_handler));
 
-    std::thread query_ws_events_sending([&] { nmos::send_query_ws_events_thread(query_ws_listener, nmos_model, nmos_websockets, nmos_mutex, query_ws_events_condition, shutdown, gate); });
+    std::thread query_ws_events_sending([&] { nmos::send_query_ws_events_thread(query_ws_listener, nmos_model, nmos_websockets, nmos_websocket_events_schedule, nmos_mutex, query_ws_events_condition, shutdown, gate); });
 
     // Configure the Registration API
 
@@ -123,7 +136,7 @@ int main(int argc, char* argv[])
 
     // Configure the Node API
 
-    web::http::experimental::listener::api_router node_api = nmos::make_node_api(self_resources, self_mutex, gate);
+    web::http::experimental::listener::api_router node_api = nmos::make_node_api(self_resources, self_mutex, streamed_replies, gate);
     web::http::experimental::listener::http_listener node_listener(web::http::experimental::listener::make_listener_uri(nmos::fields::node_port(nmos_model.settings)));
     nmos::support_api(node_listener, node_api);
 
@@ -216,6 +229,9 @@ int main(int argc, char* argv[])
         slog::log<slog::severities::error>(gate, SLOG_FLF) << e.what() << " [" << e.error_code() << "]";
     }
 
+    // once the listeners are closed, no more streamed replies can be started, so abandon any still in progress
+    streamed_replies.stop();
+
     advertiser->stop();
 
     shutdown = true;
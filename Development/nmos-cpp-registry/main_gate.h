@@ -2,8 +2,15 @@
 #define NMOS_CPP_REGISTRY_MAIN_GATE_H
 
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <iostream>
-#include "nmos/logging_api.h"
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include "nmos/bounded_queue.h"
+#include "nmos/log_model.h"
 
 namespace
 {
@@ -14,35 +21,180 @@ namespace
             << slog::put_severity_name(message.level()) << ": "
             << message.thread_id() << ": "
             << message.str()
-            << std::endl;
+            << '\n';
     }
 
+    // The logging gateway hands each message to a single consumer thread via a bounded lock-free queue, so logging threads
+    // never contend on a lock; the consumer writes messages to stdout and the log model in batches, holding the mutex which
+    // protects the log model, but it only waits for that mutex when it can hold no more messages and the overflow policy
+    // says not to discard any, so that otherwise it can always make space in the queue
+    // (this is only safe because nothing logs while holding that mutex)
     class main_gate : public slog::base_gate
     {
     public:
-        main_gate(nmos::experimental::log_model& model, std::mutex& mutex, std::atomic<slog::severity>& level) : service({ model, mutex }), level(level) {}
-        virtual ~main_gate() {}
+        main_gate(nmos::experimental::log_model& model, std::mutex& mutex, std::atomic<slog::severity>& level, std::size_t capacity = 8192)
+            : model(model)
+            , mutex(mutex)
+            , level(level)
+            , queue(capacity)
+            , policy(nmos::experimental::overflow_block)
+            , discarded(0)
+            , waiting(false)
+            , stopping(false)
+            , consumer([this] { consume(); })
+        {}
+
+        virtual ~main_gate()
+        {
+            {
+                std::lock_guard<std::mutex> lock(wake_mutex);
+                stopping = true;
+            }
+            wake.notify_one();
+            consumer.join();
+        }
 
         virtual bool pertinent(slog::severity level) const { return this->level <= level; }
-        virtual void log(const slog::log_message& message) const { service(message); }
+        virtual void log(const slog::log_message& message) const
+        {
+            queue.push(slog::async_log_message(message), policy);
+            // pairs with the fence in consume, so either the consumer finds this message before waiting, or this finds it waiting
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (waiting)
+            {
+                std::lock_guard<std::mutex> lock(wake_mutex);
+                wake.notify_one();
+            }
+        }
+
+        // what to do when messages are being logged faster than they can be written out, see nmos::experimental::overflow_policy
+        void set_overflow_policy(nmos::experimental::overflow_policy policy) { this->policy = policy; }
+
+        // the number of messages which found the queue full, and the number which were discarded as a result
+        std::uint64_t overflows() const { return queue.overflows(); }
+        std::uint64_t dropped() const { return queue.dropped(); }
 
     private:
-        struct service_function
+        void consume()
         {
-            nmos::experimental::log_model& model;
-            std::mutex& mutex;
+            const std::size_t max_batch_size = 256;
+
+            slog::async_log_message message;
+            std::uint64_t reported_dropped = 0;
+
+            for (;;)
+            {
+                const nmos::experimental::overflow_policy policy = this->policy;
+                const bool block = nmos::experimental::overflow_block == policy;
+
+                // drain the queue whether or not the messages can be written out yet, so logging threads don't wait for the mutex,
+                // unless no more messages can be held without discarding any
+                std::size_t popped = 0;
+                while (popped < max_batch_size && !(block && queue.capacity() <= held.size()) && queue.try_pop(message))
+                {
+                    hold(message, policy);
+                    ++popped;
+                }
+
+                if (!held.empty())
+                {
+                    // if the mutex is busy, keep the messages for the next round, or if there's no space to hold any more,
+                    // wait for it, so that logging threads block once the queue is also full, rather than losing messages
+                    std::unique_lock<std::mutex> lock(mutex, std::defer_lock);
+                    if (block && queue.capacity() <= held.size()) lock.lock(); else lock.try_lock();
+                    if (lock.owns_lock())
+                    {
+                        write_out(reported_dropped);
+                        continue;
+                    }
+                }
+
+                if (0 != popped) continue;
+
+                std::unique_lock<std::mutex> lock(wake_mutex);
+                if (stopping) break;
+                waiting = true;
+                // a producer only checks the flag after pushing, so check the queue again now the flag is set
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (queue.try_pop(message))
+                {
+                    hold(message, policy);
+                }
+                else if (held.empty())
+                {
+                    wake.wait(lock);
+                }
+                else
+                {
+                    // only poll while messages are being held because the mutex is busy
+                    wake.wait_for(lock, std::chrono::milliseconds(10));
+                }
+                waiting = false;
+            }
 
-            typedef const slog::async_log_message& argument_type;
-            void operator()(argument_type message) const
+            if (!held.empty())
             {
                 std::lock_guard<std::mutex> lock(mutex);
-                log_to_ostream(std::cout, message);
-                nmos::experimental::log_to_model(model, message);
+                write_out(reported_dropped);
             }
-        };
+        }
 
-        mutable slog::async_log_service<service_function> service;
+        // hold the message until the mutex can be acquired, discarding the oldest or this one according to the policy
+        // if too many are already being held (under overflow_block, the consumer stops draining the queue instead)
+        void hold(slog::async_log_message& message, nmos::experimental::overflow_policy policy)
+        {
+            if (nmos::experimental::overflow_block != policy && queue.capacity() <= held.size())
+            {
+                ++discarded;
+                if (nmos::experimental::overflow_drop_newest == policy) return;
+                held.pop_front();
+            }
+            held.push_back(std::move(message));
+        }
+
+        // write the held messages to stdout and the log model, while holding the mutex
+        void write_out(std::uint64_t& reported_dropped)
+        {
+            // one write (and flush) per batch, rather than per message
+            std::ostringstream os;
+            for (const auto& batched : held)
+            {
+                log_to_ostream(os, batched);
+            }
+            const auto dropped = queue.dropped() + discarded;
+            if (reported_dropped != dropped)
+            {
+                os << slog::put_timestamp(slog::async_log_message::clock::now()) << ": " << slog::put_severity_name(slog::severities::warning) << ": "
+                    << std::this_thread::get_id() << ": " << "Dropped " << dropped - reported_dropped << " log messages\n";
+                reported_dropped = dropped;
+            }
+            std::cout << os.str() << std::flush;
+
+            for (const auto& batched : held)
+            {
+                nmos::experimental::log_to_model(model, batched);
+            }
+            held.clear();
+        }
+
+        nmos::experimental::log_model& model;
+        std::mutex& mutex;
         std::atomic<slog::severity>& level;
+
+        mutable nmos::experimental::bounded_queue<slog::async_log_message> queue;
+        std::atomic<nmos::experimental::overflow_policy> policy;
+
+        // only accessed by the consumer
+        std::deque<slog::async_log_message> held;
+        std::uint64_t discarded;
+
+        // the consumer only waits when the queue is empty
+        mutable std::mutex wake_mutex;
+        mutable std::condition_variable wake;
+        std::atomic<bool> waiting;
+        bool stopping;
+
+        std::thread consumer;
     };
 }
 
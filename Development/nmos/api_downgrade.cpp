@@ -43,7 +43,7 @@ namespace nmos
         if (!is_permitted_downgrade(resource.version, resource.type, version, downgrade_version)) return web::json::value::null();
 
         // optimisation for the common case (old-versioned resources, if being permitted, do not get upgraded)
-        if (resource.version <= version) return resource.data;
+        if (resource.version <= version) return *resource.data;
 
         web::json::value result;
 
@@ -117,13 +117,45 @@ namespace nmos
         {
             for (auto& property : version_properties->second)
             {
-                if (resource.data.has_field(property))
+                if (resource.data->has_field(property))
                 {
-                    result[property] = resource.data.at(property);
+                    result[property] = resource.data->at(property);
                 }
             }
         }
 
         return result;
     }
+
+    std::shared_ptr<const utility::string_t> serialized_downgrade(const nmos::resource& resource, const nmos::api_version& version)
+    {
+        // resources which weren't inserted into a resources container have no cache
+        if (!resource.serialized) return std::make_shared<const utility::string_t>(downgrade(resource, version).serialize());
+
+        auto& cache = *resource.serialized;
+        {
+            std::lock_guard<std::mutex> lock(cache.mutex);
+            auto found = cache.versions.find(version);
+            if (cache.versions.end() != found) return found->second;
+        }
+
+        // serialize without holding the lock; if another thread got there first, its representation is identical
+        auto serialized = std::make_shared<const utility::string_t>(downgrade(resource, version).serialize());
+
+        std::lock_guard<std::mutex> lock(cache.mutex);
+        return cache.versions.insert({ version, serialized }).first->second;
+    }
+
+    void serialize_downgrade(utility::ostream_t& os, const std::vector<const nmos::resource*>& resources, const nmos::api_version& version)
+    {
+        os << U('[');
+        bool first = true;
+        for (auto resource : resources)
+        {
+            if (!first) os << U(',');
+            os << *serialized_downgrade(*resource, version);
+            first = false;
+        }
+        os << U(']');
+    }
 }
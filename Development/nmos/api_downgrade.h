@@ -1,14 +1,18 @@
 #ifndef NMOS_API_DOWNGRADE_H
 #define NMOS_API_DOWNGRADE_H
 
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
 #include "cpprest/json.h"
+#include "nmos/api_version.h"
 
 // "Downgrade queries permit old-versioned responses to be provided to clients which are confident
 // that they can handle any missing attributes between the specified API versions."
 // See https://github.com/AMWA-TV/nmos-discovery-registration/blob/v1.2-dev/docs/2.5.%20APIs%20-%20Query%20Parameters.md#downgrade-queries
 namespace nmos
 {
-    struct api_version;
     struct resource;
     struct type;
 
@@ -18,6 +22,20 @@ namespace nmos
 
     web::json::value downgrade(const nmos::resource& resource, const nmos::api_version& version);
     web::json::value downgrade(const nmos::resource& resource, const nmos::api_version& version, const nmos::api_version& downgrade_version);
+
+    // the cache of serialized representations of a resource, see nmos::resource::serialized
+    struct serialized_representations
+    {
+        std::mutex mutex;
+        std::map<nmos::api_version, std::shared_ptr<const utility::string_t>> versions;
+    };
+
+    // the serialized form of downgrade(resource, version), from the resource's cache where possible,
+    // so that the same representation isn't serialized again for every response until the resource is modified
+    std::shared_ptr<const utility::string_t> serialized_downgrade(const nmos::resource& resource, const nmos::api_version& version);
+
+    // write the resources as a json array of their serialized downgraded representations
+    void serialize_downgrade(utility::ostream_t& os, const std::vector<const nmos::resource*>& resources, const nmos::api_version& version);
 }
 
 #endif
@@ -1,6 +1,8 @@
 #include "nmos/api_utils.h"
 
+#include <functional>
 #include "nmos/slog.h"
+#include "nmos/version.h"
 
 namespace nmos
 {
@@ -55,6 +57,13 @@ namespace nmos
         }
     }
 
+    utility::string_t make_resources_entity_tag(const web::http::http_request& req, const tai& most_recent_update, std::size_t size)
+    {
+        utility::ostringstream_t opaque_tag;
+        opaque_tag << nmos::make_version(most_recent_update) << U('-') << size << U('-') << std::hex << std::hash<utility::string_t>()(req.relative_uri().to_string());
+        return web::http::make_entity_tag(opaque_tag.str());
+    }
+
     web::json::value make_error_response_body(web::http::status_code code, const utility::string_t& error, const utility::string_t& debug)
     {
         web::json::value result = web::json::value::object(true);
@@ -2,8 +2,10 @@
 #define NMOS_API_UTILS_H
 
 #include <map>
+#include <stdexcept>
 #include "cpprest/api_router.h"
 #include "cpprest/regex_utils.h"
+#include "nmos/tai.h"
 #include "nmos/type.h"
 
 namespace slog
@@ -52,7 +54,7 @@ namespace nmos
     }
 
     // At the moment, it happens that we could cheat and tweak the regular expression for the resourceType route patterns so that
-    // the sub_match was the singular form and thus directly the equivalent nmos::type, since that's currently just a string too,
+    // the sub_match was the singular form and thus directly the name of the equivalent nmos::type,
     // but a mapping from one to the other seems less fragile!
 
     // Also note that a subscription for a single type has resource_path == U('/') + resourceType
@@ -76,22 +78,50 @@ namespace nmos
 
     inline utility::string_t resourceType_from_type(const nmos::type& type)
     {
-        static const std::map<nmos::type, utility::string_t> map =
+        // indexed by type value, see nmos/type.h
+        static const utility::char_t* const resourceTypes[] =
         {
-            { nmos::types::node, U("nodes") },
-            { nmos::types::device, U("devices") },
-            { nmos::types::source, U("sources") },
-            { nmos::types::flow, U("flows") },
-            { nmos::types::sender, U("senders") },
-            { nmos::types::receiver, U("receivers") },
-            { nmos::types::subscription, U("subscriptions") },
-            { nmos::types::websocket, {} } // subscription websocket connections aren't exposed via the Query API
+            U("nodes"),
+            U("devices"),
+            U("sources"),
+            U("flows"),
+            U("senders"),
+            U("receivers"),
+            U("subscriptions"),
+            U("") // subscription websocket connections aren't exposed via the Query API
         };
-        return map.at(type);
+        if (0 > type.value || sizeof(resourceTypes) / sizeof(resourceTypes[0]) <= static_cast<size_t>(type.value)) throw std::out_of_range("unknown type");
+        return resourceTypes[type.value];
     }
 
     // Other utility functions for generating NMOS response headers and body
 
+    namespace experimental
+    {
+        namespace header_names
+        {
+            // the generation of the snapshot of the resources from which the response was generated, see nmos::resources_snapshot
+            const web::http::http_headers::key_type resources_generation{ U("X-Resources-Generation") };
+            // the plan used to find the candidates for a query, see nmos::resource_query_plan and nmos::experimental::log_events_query_plan
+            const web::http::http_headers::key_type query_plan{ U("X-Query-Plan") };
+        }
+    }
+
+    // HTTP headers used by the NMOS APIs
+    namespace header_names
+    {
+        // see https://github.com/AMWA-TV/nmos-discovery-registration/blob/v1.2-dev/docs/2.5.%20APIs%20-%20Query%20Parameters.md#pagination
+        const web::http::http_headers::key_type link{ U("Link") };
+        const web::http::http_headers::key_type paging_limit{ U("X-Paging-Limit") };
+        const web::http::http_headers::key_type paging_since{ U("X-Paging-Since") };
+        const web::http::http_headers::key_type paging_until{ U("X-Paging-Until") };
+    }
+
+    // make an entity-tag for a response which is determined by the request URI (including the query string) and the state of the resources,
+    // identified by their most recent update timestamp and number, since every insert or modify strictly increases the former and every
+    // erase reduces the latter; for a single resource, its update timestamp alone identifies its state
+    utility::string_t make_resources_entity_tag(const web::http::http_request& req, const tai& most_recent_update, std::size_t size = 1);
+
     // construct a standard NMOS error response, using the default reason phrase if no user error information is specified
     web::json::value make_error_response_body(web::http::status_code code, const utility::string_t& error = {}, const utility::string_t& debug = {});
 
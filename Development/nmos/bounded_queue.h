@@ -0,0 +1,194 @@
+#ifndef NMOS_BOUNDED_QUEUE_H
+#define NMOS_BOUNDED_QUEUE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include "cpprest/details/basic_types.h"
+
+namespace nmos
+{
+    namespace experimental
+    {
+        // What to do when pushing onto a full queue
+        enum overflow_policy
+        {
+            // wait for the consumer to make space
+            overflow_block,
+            // discard the oldest element in the queue to make space
+            overflow_drop_oldest,
+            // discard the element being pushed
+            overflow_drop_newest
+        };
+
+        // "block", "drop_oldest" or "drop_newest"; anything else is treated as "block", which never loses anything
+        inline overflow_policy parse_overflow_policy(const utility::string_t& policy)
+        {
+            if (U("drop_oldest") == policy) return overflow_drop_oldest;
+            if (U("drop_newest") == policy) return overflow_drop_newest;
+            return overflow_block;
+        }
+
+        // A bounded lock-free queue, intended for many producers and a single consumer, e.g. the threads logging messages
+        // and the thread writing them out
+        // This is Dmitry Vyukov's bounded MPMC queue, in which each cell has a sequence number that tells producers and
+        // consumers whether it's ready for them, so they only contend on the enqueue and dequeue positions respectively
+        // See http://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+        // Since it's safe for more than one consumer, a producer can also pop the oldest element to make space
+        template <typename T>
+        class bounded_queue
+        {
+        public:
+            // the capacity is rounded up to a power of two
+            explicit bounded_queue(std::size_t capacity)
+                : mask(round_up_to_power_of_two(capacity) - 1)
+                , cells(new cell[mask + 1])
+                , enqueue_pos(0)
+                , dequeue_pos(0)
+                , overflows_(0)
+                , dropped_(0)
+            {
+                for (std::size_t i = 0; i <= mask; ++i)
+                {
+                    cells[i].sequence.store(i, std::memory_order_relaxed);
+                }
+            }
+
+            ~bounded_queue()
+            {
+                T discard;
+                while (try_pop(discard)) {}
+            }
+
+            std::size_t capacity() const { return mask + 1; }
+
+            // push the value if there's space, and return whether it was pushed; the value is only moved from if so
+            bool try_push(T& value)
+            {
+                cell* c;
+                std::size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+                for (;;)
+                {
+                    c = &cells[pos & mask];
+                    const std::size_t sequence = c->sequence.load(std::memory_order_acquire);
+                    const std::intptr_t diff = (std::intptr_t)sequence - (std::intptr_t)pos;
+                    if (0 == diff)
+                    {
+                        if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+                    }
+                    else if (0 > diff)
+                    {
+                        // full
+                        return false;
+                    }
+                    else
+                    {
+                        pos = enqueue_pos.load(std::memory_order_relaxed);
+                    }
+                }
+                new (&c->storage) T(std::move(value));
+                c->sequence.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+
+            // pop the oldest value if there is one, and return whether there was
+            bool try_pop(T& value)
+            {
+                cell* c;
+                std::size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+                for (;;)
+                {
+                    c = &cells[pos & mask];
+                    const std::size_t sequence = c->sequence.load(std::memory_order_acquire);
+                    const std::intptr_t diff = (std::intptr_t)sequence - (std::intptr_t)(pos + 1);
+                    if (0 == diff)
+                    {
+                        if (dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+                    }
+                    else if (0 > diff)
+                    {
+                        // empty
+                        return false;
+                    }
+                    else
+                    {
+                        pos = dequeue_pos.load(std::memory_order_relaxed);
+                    }
+                }
+                T* element = reinterpret_cast<T*>(&c->storage);
+                value = std::move(*element);
+                element->~T();
+                c->sequence.store(pos + mask + 1, std::memory_order_release);
+                return true;
+            }
+
+            // push the value, applying the policy if the queue is full, and return whether it was pushed
+            bool push(T value, overflow_policy policy)
+            {
+                if (try_push(value)) return true;
+                ++overflows_;
+
+                for (;;)
+                {
+                    if (overflow_drop_newest == policy)
+                    {
+                        ++dropped_;
+                        return false;
+                    }
+                    else if (overflow_drop_oldest == policy)
+                    {
+                        T oldest;
+                        if (try_pop(oldest)) ++dropped_;
+                    }
+                    else // if (overflow_block == policy)
+                    {
+                        std::this_thread::yield();
+                    }
+
+                    if (try_push(value)) return true;
+                }
+            }
+
+            // the number of pushes which found the queue full
+            std::uint64_t overflows() const { return overflows_; }
+            // the number of elements discarded due to the overflow policy
+            std::uint64_t dropped() const { return dropped_; }
+
+        private:
+            // Non-copyable
+            bounded_queue(const bounded_queue&);
+            bounded_queue& operator=(const bounded_queue&);
+
+            struct cell
+            {
+                std::atomic<std::size_t> sequence;
+                typename std::aligned_storage<sizeof(T), std::alignment_of<T>::value>::type storage;
+            };
+
+            static std::size_t round_up_to_power_of_two(std::size_t capacity)
+            {
+                std::size_t result = 2;
+                while (result < capacity) result <<= 1;
+                return result;
+            }
+
+            const std::size_t mask;
+            std::unique_ptr<cell[]> cells;
+
+            // the producers and the consumer(s) each have their own position, on separate cache lines
+            char pad0[64];
+            std::atomic<std::size_t> enqueue_pos;
+            char pad1[64];
+            std::atomic<std::size_t> dequeue_pos;
+            char pad2[64];
+
+            std::atomic<std::uint64_t> overflows_;
+            std::atomic<std::uint64_t> dropped_;
+        };
+    }
+}
+
+#endif
@@ -83,14 +83,14 @@ namespace nmos
 
             const string_t resourceType = parameters.at(nmos::patterns::connectorType.name);
 
-            const auto match = [&](const nmos::resources::value_type& resource) { return resource.type == nmos::type_from_resourceType(resourceType) && nmos::is_permitted_downgrade(resource, nmos::is04_versions::v1_2); };
+            const auto match = [&](const nmos::resources::value_type& resource) { return nmos::is_permitted_downgrade(resource, nmos::is04_versions::v1_2); };
 
             size_t count = 0;
 
             set_reply(res, status_codes::OK,
-                web::json::serialize_if(resources,
+                web::json::serialize_if(get_resources_of_type(resources, nmos::type_from_resourceType(resourceType)),
                     match,
-                    [&count](const nmos::resources::value_type& resource) { ++count; return value(resource.id + U("/")); }),
+                    [&count](const nmos::resources::value_type& resource) { ++count; return value(nmos::fields::id(*resource.data) + U("/")); }),
                 U("application/json"));
 
             slog::log<slog::severities::info>(gate, SLOG_FLF) << nmos::api_stash(req, parameters) << "Returning " << count << " matching " << resourceType;
@@ -167,9 +167,10 @@ namespace nmos
                     {
                         modify_resource(resources, resourceId, [&](nmos::resource& resource)
                         {
-                            resource.data[U("version")] = value::string(nmos::make_version(resource.updated));
+                            auto data = *resource.data;
+                            data[U("version")] = value::string(nmos::make_version(resource.updated));
 
-                            auto& subscription = resource.data[U("subscription")];
+                            auto& subscription = data[U("subscription")];
                             subscription[U("active")] = value::boolean(master_enable);
                             if (nmos::types::sender == resource.type)
                             {
@@ -179,6 +180,8 @@ namespace nmos
                             {
                                 subscription[U("sender_id")] = master_enable ? body[U("sender_id")] : value::null();
                             }
+
+                            resource.data = std::make_shared<const value>(std::move(data));
                         });
 
                         set_reply(res, status_codes::OK, value{});
@@ -0,0 +1,95 @@
+#include "nmos/id.h"
+
+#include <random>
+
+namespace nmos
+{
+    namespace details
+    {
+        // the state of a xorshift128+ generator, see http://vigna.di.unimi.it/ftp/papers/xorshiftplus.pdf
+        // which is fast, and passes BigCrush, though isn't cryptographically secure, which UUIDs don't need to be
+        // it's plain old data so that it can be thread-local even without thread_local (i.e. on Visual Studio 2013)
+        struct uuid_generator_state
+        {
+            std::uint64_t s[2];
+            bool seeded;
+        };
+
+#if defined(_MSC_VER) && _MSC_VER < 1900
+        __declspec(thread) uuid_generator_state uuid_generator;
+#else
+        thread_local uuid_generator_state uuid_generator;
+#endif
+
+        inline void seed(uuid_generator_state& state)
+        {
+            std::random_device device;
+            // the state must not be all zero
+            do
+            {
+                for (auto& word : state.s)
+                {
+                    word = std::uint64_t(device()) << 32 | device();
+                }
+            } while (0 == state.s[0] && 0 == state.s[1]);
+            state.seeded = true;
+        }
+
+        inline std::uint64_t next(uuid_generator_state& state)
+        {
+            std::uint64_t s1 = state.s[0];
+            const std::uint64_t s0 = state.s[1];
+            state.s[0] = s0;
+            s1 ^= s1 << 23;
+            state.s[1] = s1 ^ s0 ^ (s1 >> 17) ^ (s0 >> 26);
+            return state.s[1] + s0;
+        }
+
+        inline boost::uuids::uuid make_random_uuid(uuid_generator_state& state)
+        {
+            if (!state.seeded) seed(state);
+
+            boost::uuids::uuid uuid;
+            const std::uint64_t words[2] = { next(state), next(state) };
+            std::memcpy(uuid.data, words, sizeof(words));
+
+            // set the version (random) and the variant (RFC 4122)
+            uuid.data[6] = (uuid.data[6] & 0x0F) | 0x40;
+            uuid.data[8] = (uuid.data[8] & 0x3F) | 0x80;
+            return uuid;
+        }
+
+        // format a UUID in the canonical form, i.e. xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxxxx, where x is a lower-case hex digit
+        // directly, rather than via boost::uuids::to_string and utility::s2us
+        inline id format_uuid(const boost::uuids::uuid& uuid)
+        {
+            static const utility::char_t digits[] = U("0123456789abcdef");
+            id result(36, U('-'));
+            auto out = result.begin();
+            for (std::size_t i = 0; i < uuid.size(); ++i)
+            {
+                if (4 == i || 6 == i || 8 == i || 10 == i) ++out;
+                *out++ = digits[uuid.data[i] >> 4];
+                *out++ = digits[uuid.data[i] & 0x0F];
+            }
+            return result;
+        }
+    }
+
+    id make_id()
+    {
+        return details::format_uuid(details::make_random_uuid(details::uuid_generator));
+    }
+
+    std::vector<id> make_ids(std::size_t count)
+    {
+        auto& state = details::uuid_generator;
+        std::vector<id> result;
+        result.reserve(count);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            result.push_back(details::format_uuid(details::make_random_uuid(state)));
+        }
+        return result;
+    }
+}
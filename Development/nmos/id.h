@@ -1,7 +1,11 @@
 #ifndef NMOS_ID_H
 #define NMOS_ID_H
 
-#include <boost/uuid/random_generator.hpp>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <vector>
+#include <boost/uuid/name_generator.hpp>
 #include <boost/uuid/uuid_io.hpp>
 #include "cpprest/basic_utils.h"
 
@@ -14,9 +18,84 @@ namespace nmos
     // inconsistent between implementations in the past, they are currently stored simply as strings...
     typedef utility::string_t id;
 
-    inline id make_id()
+    // make a random (version 4) UUID, in the canonical form
+    // the UUIDs come from a fast pseudo-random number generator per thread, which is seeded once from the OS entropy source,
+    // rather than from a new boost::uuids::random_generator each time, since constructing one involves seeding it
+    id make_id();
+
+    // make the specified number of ids at once
+    std::vector<id> make_ids(std::size_t count);
+
+    // ... except within the registry containers, where a compact binary form is used as the key, i.e. 16 bytes,
+    // trivially copyable and quick to hash, rather than a 36-character string
+    // Identifiers in the canonical (lower-case, hyphenated) form are simply parsed; anything else is mapped
+    // to a name-based UUID, so that every distinct id string still has a distinct compact_id
+    // The conversion is implicit to allow a container keyed on compact_id to be searched using an id
+    struct compact_id
+    {
+        compact_id() : uuid() {}
+        compact_id(const id& id);
+
+        boost::uuids::uuid uuid;
+
+        friend bool operator==(const compact_id& lhs, const compact_id& rhs) { return lhs.uuid == rhs.uuid; }
+        friend bool operator< (const compact_id& lhs, const compact_id& rhs) { return lhs.uuid <  rhs.uuid; }
+        friend bool operator> (const compact_id& lhs, const compact_id& rhs) { return rhs < lhs; }
+        friend bool operator!=(const compact_id& lhs, const compact_id& rhs) { return !(lhs == rhs); }
+        friend bool operator<=(const compact_id& lhs, const compact_id& rhs) { return !(rhs < lhs); }
+        friend bool operator>=(const compact_id& lhs, const compact_id& rhs) { return !(lhs < rhs); }
+
+        // the canonical form, e.g. for test diagnostics (non-canonical ids can't be recovered from their name-based UUIDs)
+        template <typename CharType, typename CharTraits>
+        friend std::basic_ostream<CharType, CharTraits>& operator<<(std::basic_ostream<CharType, CharTraits>& os, const compact_id& id) { return os << id.uuid; }
+    };
+
+    namespace details
+    {
+        inline int hex_digit_value(utility::char_t ch)
+        {
+            return U('0') <= ch && ch <= U('9') ? ch - U('0') : U('a') <= ch && ch <= U('f') ? ch - U('a') + 10 : -1;
+        }
+
+        // parse an id of the form xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxxxx, where x is a lower-case hex digit
+        inline bool parse_canonical_uuid(boost::uuids::uuid& uuid, const id& id)
+        {
+            if (36 != id.size()) return false;
+            auto byte = uuid.begin();
+            for (utility::string_t::size_type i = 0; i < 36;)
+            {
+                if (8 == i || 13 == i || 18 == i || 23 == i)
+                {
+                    if (U('-') != id[i]) return false;
+                    ++i;
+                    continue;
+                }
+                const int hi = hex_digit_value(id[i]);
+                const int lo = hex_digit_value(id[i + 1]);
+                if (0 > hi || 0 > lo) return false;
+                *byte++ = static_cast<boost::uuids::uuid::value_type>(hi << 4 | lo);
+                i += 2;
+            }
+            return true;
+        }
+    }
+
+    inline compact_id::compact_id(const id& id)
+    {
+        if (!details::parse_canonical_uuid(uuid, id))
+        {
+            // an arbitrary namespace for name-based UUIDs generated from non-canonical ids
+            boost::uuids::uuid ns = {{ 0x5c, 0x6f, 0x5d, 0x46, 0x2a, 0x37, 0x4c, 0x1e, 0x9b, 0x8d, 0x0e, 0x61, 0xd3, 0x4a, 0x77, 0x02 }};
+            uuid = boost::uuids::name_generator(ns)(id);
+        }
+    }
+
+    // the bytes of a UUID are already well distributed (or at least, all but a few bits are), so hashing can just fold them together
+    inline std::size_t hash_value(const compact_id& id)
     {
-        return utility::s2us(boost::uuids::to_string(boost::uuids::random_generator()()));
+        std::uint64_t words[2];
+        std::memcpy(words, id.uuid.data, sizeof(words));
+        return static_cast<std::size_t>(words[0] ^ words[1]);
     }
 }
 
@@ -13,10 +13,10 @@ namespace nmos
         {
             for (auto& resource : model.resources)
             {
-                s << resource.type << ' ' << resource.id.substr(0, 6) << ' ' << make_version(resource.created) << ' ' << make_version(resource.updated) << '\n';
-                for (auto& sub_resource : resource.sub_resources)
+                s << resource.type.name() << ' ' << nmos::fields::id(*resource.data).substr(0, 6) << ' ' << make_version(resource.created) << ' ' << make_version(resource.updated) << '\n';
+                for (auto& sub_resource : get_sub_resources(model.resources, resource))
                 {
-                    s << "  " << sub_resource.substr(0, 6) << '\n';
+                    s << "  " << nmos::fields::id(*sub_resource.data).substr(0, 6) << '\n';
                 }
             }
         });
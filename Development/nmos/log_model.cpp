@@ -0,0 +1,603 @@
+#include "nmos/log_model.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <sstream>
+
+namespace nmos
+{
+    namespace experimental
+    {
+        namespace detail
+        {
+            inline web::json::value json_from_string(const std::string& s)
+            {
+                return web::json::value{ utility::s2us(s) };
+            }
+
+            template <typename T>
+            inline std::string ostringstreamed(const T& value)
+            {
+                return [&]{ std::ostringstream os; os << value; return os.str(); }();
+            }
+
+            inline std::size_t total_size(const log_event_record& record)
+            {
+                std::size_t result = 0;
+                for (auto length : record.lengths) result += length;
+                return result;
+            }
+
+            // truncate a UTF-8 string to at most the specified size, without splitting a multi-byte character
+            inline void truncate_utf8(std::string& s, std::size_t size)
+            {
+                if (s.size() <= size) return;
+                while (0 < size && 0x80 == (s[size] & 0xC0)) --size;
+                s.resize(size);
+            }
+
+            inline std::string format_timestamp(const slog::async_log_message::time_point& timestamp)
+            {
+                return ostringstreamed(slog::put_timestamp(timestamp, "%Y-%m-%dT%H:%M:%06.3SZ"));
+            }
+
+            // call the function with each name and value of the stored route parameters, i.e. a sequence of null-terminated
+            // names and values, without copying them
+            template <typename Function>
+            inline void for_each_route_parameter(const std::string& route_parameters, Function f)
+            {
+                for (std::string::size_type name = 0, value, end; route_parameters.size() > name; name = end + 1)
+                {
+                    value = route_parameters.find('\0', name);
+                    if (std::string::npos == value) break;
+                    end = route_parameters.find('\0', value + 1);
+                    if (std::string::npos == end) break;
+                    f(route_parameters.data() + name, value - name, route_parameters.data() + value + 1, end - value - 1);
+                }
+            }
+
+            inline std::vector<std::pair<std::string, std::string>> split_route_parameters(const std::string& route_parameters)
+            {
+                std::vector<std::pair<std::string, std::string>> result;
+                for_each_route_parameter(route_parameters, [&result](const char* name, std::size_t name_size, const char* value, std::size_t value_size)
+                {
+                    result.push_back({ std::string(name, name_size), std::string(value, value_size) });
+                });
+                return result;
+            }
+
+            // remove the specified sequence number from an index, which since events are evicted in sequence order,
+            // must be the first for the key
+            template <typename Index>
+            inline void erase_front(Index& index, const typename Index::key_type& key, std::uint64_t sequence)
+            {
+                const auto found = index.find(key);
+                if (index.end() == found || found->second.empty() || sequence != found->second.front()) return;
+                found->second.pop_front();
+                if (found->second.empty()) index.erase(found);
+            }
+        }
+
+        log_events::log_events(std::size_t capacity, std::size_t average_size)
+            : records((std::max)(capacity, std::size_t(1)))
+            , begin_sequence_(0)
+            , end_sequence_(0)
+            , strings((std::max)(capacity, std::size_t(1)) * (std::max)(average_size, std::size_t(1)))
+            , begin_strings(0)
+            , end_strings(0)
+            , id_base(nmos::make_id())
+        {}
+
+        void log_events::set_capacity(std::size_t capacity, std::size_t average_size)
+        {
+            log_events resized(capacity, average_size);
+            resized.id_base = id_base;
+
+            // keep as many of the most recent events as there is space for
+            std::uint64_t first = end_sequence_;
+            std::size_t size = 0;
+            while (begin_sequence_ != first && end_sequence_ - first < resized.records.size())
+            {
+                const auto event_size = detail::total_size(at(first - 1));
+                if (resized.strings.size() < size + event_size) break;
+                size += event_size;
+                --first;
+            }
+
+            resized.begin_sequence_ = resized.end_sequence_ = first;
+            for (auto sequence = first; end_sequence_ != sequence; ++sequence)
+            {
+                auto& record = resized.records[sequence % resized.records.size()];
+                record = at(sequence);
+                record.strings = resized.end_strings;
+                for (int field = 0; field < log_event_record::string_field_count; ++field)
+                {
+                    const auto s = get_string(sequence, log_event_record::string_field(field));
+                    resized.push_string(s.data(), s.size());
+                }
+                resized.insert_indices(sequence);
+                ++resized.end_sequence_;
+            }
+
+            *this = std::move(resized);
+        }
+
+        void log_events::push_back(const slog::async_log_message& message)
+        {
+            std::string fields[log_event_record::string_field_count];
+            fields[log_event_record::file] = message.file();
+            fields[log_event_record::function] = message.function();
+            fields[log_event_record::message] = message.str();
+
+            const auto http_method = nmos::get_http_method_stash(message.stream());
+            if (!http_method.empty()) fields[log_event_record::http_method] = utility::us2s(http_method);
+            const auto request_uri = nmos::get_request_uri_stash(message.stream());
+            if (!request_uri.is_empty()) fields[log_event_record::request_uri] = utility::us2s(request_uri.to_string());
+            for (const auto& parameter : nmos::get_route_parameters_stash(message.stream()))
+            {
+                auto& route_parameters = fields[log_event_record::route_parameters];
+                route_parameters.append(utility::us2s(parameter.first)).push_back('\0');
+                route_parameters.append(utility::us2s(parameter.second)).push_back('\0');
+            }
+
+            std::size_t size = 0;
+            for (const auto& field : fields) size += field.size();
+
+            // an event that could never fit is truncated, the message first, then its other strings are dropped
+            if (strings.size() < size)
+            {
+                auto& message_field = fields[log_event_record::message];
+                const auto excess = size - strings.size();
+                const auto message_size = message_field.size();
+                detail::truncate_utf8(message_field, excess < message_size ? message_size - excess : 0);
+                size -= message_size - message_field.size();
+                for (int field = 0; strings.size() < size && field < log_event_record::string_field_count; ++field)
+                {
+                    size -= fields[field].size();
+                    fields[field].clear();
+                }
+            }
+
+            // discard the oldest events to make space
+            while (!empty() && (records.size() == this->size() || strings.size() < end_strings + size - begin_strings))
+            {
+                pop_front();
+            }
+
+            auto& record = records[end_sequence_ % records.size()];
+            record.timestamp = message.timestamp();
+            record.thread_id = message.thread_id();
+            record.level = message.level();
+            record.line = message.line();
+            record.strings = end_strings;
+            for (int field = 0; field < log_event_record::string_field_count; ++field)
+            {
+                record.lengths[field] = static_cast<std::uint32_t>(fields[field].size());
+                push_string(fields[field].data(), fields[field].size());
+            }
+            insert_indices(end_sequence_);
+            ++end_sequence_;
+        }
+
+        void log_events::clear()
+        {
+            begin_sequence_ = end_sequence_;
+            begin_strings = end_strings;
+            levels_.clear();
+            http_methods_.clear();
+            route_parameters_.clear();
+        }
+
+        void log_events::pop_front()
+        {
+            erase_indices(begin_sequence_);
+            ++begin_sequence_;
+            begin_strings = empty() ? end_strings : at(begin_sequence_).strings;
+        }
+
+        std::uint64_t log_events::push_string(const char* data, std::size_t size)
+        {
+            const auto result = end_strings;
+            const auto offset = static_cast<std::size_t>(end_strings % strings.size());
+            const auto first = (std::min)(size, strings.size() - offset);
+            if (0 != first) std::memcpy(&strings[offset], data, first);
+            if (first != size) std::memcpy(&strings[0], data + first, size - first);
+            end_strings += size;
+            return result;
+        }
+
+        // new keys are copied into the indices, but otherwise the strings are read into the scratch strings to look them up
+        void log_events::insert_indices(std::uint64_t sequence)
+        {
+            const auto& record = at(sequence);
+            levels_[record.level].push_back(sequence);
+            if (0 != record.lengths[log_event_record::http_method])
+            {
+                get_string(sequence, log_event_record::http_method, scratch_string);
+                http_methods_[scratch_string].push_back(sequence);
+            }
+            if (0 != record.lengths[log_event_record::route_parameters])
+            {
+                get_string(sequence, log_event_record::route_parameters, scratch_string);
+                detail::for_each_route_parameter(scratch_string, [this, sequence](const char* name, std::size_t name_size, const char* value, std::size_t value_size)
+                {
+                    scratch_key.first.assign(name, name_size);
+                    scratch_key.second.assign(value, value_size);
+                    route_parameters_[scratch_key].push_back(sequence);
+                });
+            }
+        }
+
+        void log_events::erase_indices(std::uint64_t sequence)
+        {
+            const auto& record = at(sequence);
+            detail::erase_front(levels_, record.level, sequence);
+            if (0 != record.lengths[log_event_record::http_method])
+            {
+                get_string(sequence, log_event_record::http_method, scratch_string);
+                detail::erase_front(http_methods_, scratch_string, sequence);
+            }
+            if (0 != record.lengths[log_event_record::route_parameters])
+            {
+                get_string(sequence, log_event_record::route_parameters, scratch_string);
+                detail::for_each_route_parameter(scratch_string, [this, sequence](const char* name, std::size_t name_size, const char* value, std::size_t value_size)
+                {
+                    scratch_key.first.assign(name, name_size);
+                    scratch_key.second.assign(value, value_size);
+                    detail::erase_front(route_parameters_, scratch_key, sequence);
+                });
+            }
+        }
+
+        std::string log_events::get_string(std::uint64_t sequence, log_event_record::string_field field) const
+        {
+            std::string result;
+            get_string(sequence, field, result);
+            return result;
+        }
+
+        void log_events::get_string(std::uint64_t sequence, log_event_record::string_field field, std::string& result) const
+        {
+            const auto& record = at(sequence);
+            std::uint64_t position = record.strings;
+            for (int preceding = 0; preceding < field; ++preceding) position += record.lengths[preceding];
+            const std::size_t size = record.lengths[field];
+
+            result.resize(size);
+            const auto offset = static_cast<std::size_t>(position % strings.size());
+            const auto first = (std::min)(size, strings.size() - offset);
+            if (0 != first) std::memcpy(&result[0], &strings[offset], first);
+            if (first != size) std::memcpy(&result[first], &strings[0], size - first);
+        }
+
+        std::uint64_t log_events::find(const nmos::id& id) const
+        {
+            const compact_id compact(id);
+            if (0 != std::memcmp(compact.uuid.data, id_base.uuid.data, 10)) return end_sequence_;
+
+            std::uint64_t sequence = 0;
+            for (int i = 10; i < 16; ++i) sequence = sequence << 8 | compact.uuid.data[i];
+            return begin_sequence_ <= sequence && sequence < end_sequence_ ? sequence : end_sequence_;
+        }
+
+        nmos::id log_events::event_id(std::uint64_t sequence) const
+        {
+            boost::uuids::uuid uuid = id_base.uuid;
+            for (int i = 15; i >= 10; --i, sequence >>= 8) uuid.data[i] = static_cast<boost::uuids::uuid::value_type>(sequence & 0xFF);
+            return utility::s2us(boost::uuids::to_string(uuid));
+        }
+
+        web::json::value log_events::json(std::uint64_t sequence) const
+        {
+            const auto& record = at(sequence);
+
+            web::json::value json_source_location = web::json::value::object(true);
+            json_source_location[U("file")] = detail::json_from_string(get_string(sequence, log_event_record::file));
+            json_source_location[U("line")] = record.line;
+            json_source_location[U("function")] = detail::json_from_string(get_string(sequence, log_event_record::function));
+
+            web::json::value json_message = web::json::value::object(true);
+            json_message[U("timestamp")] = detail::json_from_string(detail::format_timestamp(record.timestamp));
+            json_message[U("level")] = record.level;
+            json_message[U("level_name")] = detail::json_from_string(detail::ostringstreamed(slog::put_severity_name(record.level)));
+            json_message[U("thread_id")] = detail::json_from_string(detail::ostringstreamed(record.thread_id));
+            json_message[U("source_location")] = json_source_location;
+            json_message[U("message")] = detail::json_from_string(get_string(sequence, log_event_record::message));
+
+            if (0 != record.lengths[log_event_record::http_method]) json_message[U("http_method")] = detail::json_from_string(get_string(sequence, log_event_record::http_method));
+            if (0 != record.lengths[log_event_record::request_uri]) json_message[U("request_uri")] = detail::json_from_string(get_string(sequence, log_event_record::request_uri));
+            if (0 != record.lengths[log_event_record::route_parameters])
+            {
+                web::json::value json_route_parameters = web::json::value::object();
+                for (const auto& parameter : detail::split_route_parameters(get_string(sequence, log_event_record::route_parameters)))
+                {
+                    json_route_parameters[utility::s2us(parameter.first)] = detail::json_from_string(parameter.second);
+                }
+                json_message[U("route_parameters")] = json_route_parameters;
+            }
+
+            // the id just allows the API to provide access to single events in the standard REST manner
+            json_message[U("id")] = web::json::value::string(event_id(sequence));
+            return json_message;
+        }
+
+        void log_to_model(log_model& model, const slog::async_log_message& message)
+        {
+            model.events.push_back(message);
+        }
+
+        log_events_query::log_events_query(const web::json::value& basic_query, const web::json::value& rql_query)
+            : basic_query(basic_query)
+            , rql_query(rql_query)
+            , match_flags(web::json::match_icase | web::json::match_substr)
+            , basic_matcher(basic_query, match_flags)
+            , rql_matcher(rql_query.is_null() ? rql::compiled_query() : rql::compiled_query(rql_query))
+        {}
+
+        log_events_query::result_type log_events_query::operator()(argument_type event) const
+        {
+            return basic_matcher(event)
+                && (rql_query.is_null() || rql::value_true == rql_matcher(event.as_object()));
+        }
+
+        // Query plans
+
+        namespace detail
+        {
+            typedef std::vector<std::uint64_t> sequences;
+
+            // find the events in a range of an index with keys satisfying the predicate, which is evaluated once per key
+            template <typename Index, typename Predicate>
+            sequences find_keys(const Index&, typename Index::const_iterator first, typename Index::const_iterator last, Predicate pred)
+            {
+                sequences result;
+                for (; last != first; ++first)
+                {
+                    if (pred(first->first)) result.insert(result.end(), first->second.begin(), first->second.end());
+                }
+                std::sort(result.begin(), result.end());
+                return result;
+            }
+
+            template <typename Index, typename Predicate>
+            sequences find_keys(const Index& index, Predicate pred)
+            {
+                return find_keys(index, index.begin(), index.end(), pred);
+            }
+
+            // find the range of the route parameter index with the specified name
+            inline std::pair<log_events::route_parameter_index::const_iterator, log_events::route_parameter_index::const_iterator> equal_name_range(const log_events::route_parameter_index& index, const std::string& name)
+            {
+                auto first = index.lower_bound({ name, std::string() });
+                auto last = first;
+                while (index.end() != last && name == last->first.first) ++last;
+                return{ first, last };
+            }
+
+            typedef slog::async_log_message::time_point time_point;
+
+            // find the least time point which is formatted as not less than (or, if strict, greater than) the string, by bisection
+            // between the least and greatest timestamps of the events, since formatting preserves the order, or the maximum
+            // time point if no event's timestamp is
+            inline time_point lower_bound_formatted(const log_events& events, const std::string& s, bool strict)
+            {
+                if (events.empty()) return (time_point::max)();
+                const auto not_less = [&s, strict](const time_point& timestamp) -> bool
+                {
+                    const auto formatted = format_timestamp(timestamp);
+                    return strict ? s < formatted : !(formatted < s);
+                };
+                auto lower = events.at(events.begin_sequence()).timestamp;
+                auto upper = lower;
+                for (auto sequence = events.begin_sequence(); events.end_sequence() != sequence; ++sequence)
+                {
+                    const auto& timestamp = events.at(sequence).timestamp;
+                    if (timestamp < lower) lower = timestamp;
+                    if (upper < timestamp) upper = timestamp;
+                }
+                if (!not_less(upper)) return (time_point::max)();
+                while (lower < upper)
+                {
+                    const auto middle = lower + (upper - lower) / 2;
+                    if (not_less(middle)) upper = middle;
+                    else lower = middle + time_point::duration(1);
+                }
+                return lower;
+            }
+
+            // find the events with timestamps in the half-open range [first, last), by a scan of the records
+            inline sequences find_timestamps(const log_events& events, const time_point& first, const time_point& last)
+            {
+                sequences result;
+                for (auto sequence = events.begin_sequence(); events.end_sequence() != sequence; ++sequence)
+                {
+                    const auto& timestamp = events.at(sequence).timestamp;
+                    if (!(timestamp < first) && timestamp < last) result.push_back(sequence);
+                }
+                return result;
+            }
+
+            // construct an object with just the specified field, to match a query term against only the value of an indexed field
+            inline web::json::value make_field(const utility::string_t& field, const web::json::value& value)
+            {
+                web::json::value result = web::json::value::object();
+                result[field] = value;
+                return result;
+            }
+
+            // whether the RQL term compares a property with a literal, e.g. ge(level,10), so depends on only that property
+            inline bool is_comparison(const web::json::value& term, utility::string_t& property)
+            {
+                if (!rql::is_call_operator(term)) return false;
+                const auto& name = term.at(U("name")).as_string();
+                if (U("eq") != name && U("ne") != name && U("lt") != name && U("le") != name && U("gt") != name && U("ge") != name && U("in") != name) return false;
+                const auto& args = term.at(U("args"));
+                if (!args.is_array() || 2 != args.size() || !args.at(0).is_string() || rql::is_call_operator(args.at(1))) return false;
+                if (args.at(1).is_array())
+                {
+                    for (const auto& element : args.at(1).as_array())
+                    {
+                        if (rql::is_call_operator(element)) return false;
+                    }
+                }
+                property = args.at(0).as_string();
+                return true;
+            }
+
+            // split e.g. "route_parameters.resourceType" into the route parameter name
+            inline bool is_route_parameter(const utility::string_t& property, utility::string_t& name)
+            {
+                static const utility::string_t prefix(U("route_parameters."));
+                if (0 != property.compare(0, prefix.size(), prefix)) return false;
+                name = property.substr(prefix.size());
+                return !name.empty() && utility::string_t::npos == name.find(U('.'));
+            }
+        }
+
+        log_events_query_plan plan_log_events_query(const log_events& events, const log_events_query& query)
+        {
+            log_events_query_plan plan;
+            std::vector<detail::sequences> found;
+
+            // every term must be satisfied, so the matching events are in the intersection of the events found for each indexed
+            // term, and if every term is indexed, they are exactly that intersection
+            const auto add = [&plan, &found](const utility::string_t& field, detail::sequences sequences)
+            {
+                plan.fields.push_back(field);
+                found.push_back(std::move(sequences));
+            };
+
+            if (query.basic_query.is_object())
+            {
+                for (const auto& field : query.basic_query.as_object())
+                {
+                    if (U("level") == field.first)
+                    {
+                        const web::json::query_matcher match(detail::make_field(field.first, field.second), query.match_flags);
+                        add(field.first, detail::find_keys(events.levels(), [&match](slog::severity level) -> bool
+                        {
+                            return match(detail::make_field(U("level"), web::json::value::number(level)));
+                        }));
+                    }
+                    else if (U("http_method") == field.first)
+                    {
+                        const web::json::query_matcher match(detail::make_field(field.first, field.second), query.match_flags);
+                        add(field.first, detail::find_keys(events.http_methods(), [&match](const std::string& http_method) -> bool
+                        {
+                            return match(detail::make_field(U("http_method"), detail::json_from_string(http_method)));
+                        }));
+                    }
+                    else if (U("route_parameters") == field.first && field.second.is_object() && 0 != field.second.size())
+                    {
+                        for (const auto& parameter : field.second.as_object())
+                        {
+                            const auto& name = parameter.first;
+                            const web::json::query_matcher match(detail::make_field(name, parameter.second), query.match_flags);
+                            const auto range = detail::equal_name_range(events.route_parameters(), utility::us2s(name));
+                            add(field.first + U(".") + name, detail::find_keys(events.route_parameters(), range.first, range.second, [&match, &name](const std::pair<std::string, std::string>& key) -> bool
+                            {
+                                return match(detail::make_field(name, detail::json_from_string(key.second)));
+                            }));
+                        }
+                    }
+                    else
+                    {
+                        plan.exact = false;
+                    }
+                }
+            }
+
+            if (!query.rql_query.is_null())
+            {
+                const bool conjunction = rql::is_call_operator(query.rql_query) && U("and") == query.rql_query.at(U("name")).as_string() && query.rql_query.at(U("args")).is_array();
+                const auto terms = conjunction ? query.rql_query.at(U("args")) : web::json::value::array({ query.rql_query });
+
+                for (const auto& term : terms.as_array())
+                {
+                    utility::string_t property;
+                    utility::string_t name;
+                    if (!detail::is_comparison(term, property))
+                    {
+                        plan.exact = false;
+                    }
+                    else if (U("level") == property)
+                    {
+                        const rql::compiled_query match(term);
+                        add(property, detail::find_keys(events.levels(), [&match](slog::severity level) -> bool
+                        {
+                            return rql::value_true == match(detail::make_field(U("level"), web::json::value::number(level)).as_object());
+                        }));
+                    }
+                    else if (U("http_method") == property)
+                    {
+                        const rql::compiled_query match(term);
+                        add(property, detail::find_keys(events.http_methods(), [&match](const std::string& http_method) -> bool
+                        {
+                            return rql::value_true == match(detail::make_field(U("http_method"), detail::json_from_string(http_method)).as_object());
+                        }));
+                    }
+                    else if (U("timestamp") == property && term.at(U("args")).at(1).is_string() && U("ne") != term.at(U("name")).as_string() && U("in") != term.at(U("name")).as_string())
+                    {
+                        // timestamps are compared as strings, so find the range of time points by bisection, rather than formatting every one
+                        const auto& op = term.at(U("name")).as_string();
+                        const auto s = utility::us2s(term.at(U("args")).at(1).as_string());
+                        const auto not_less = detail::lower_bound_formatted(events, s, false);
+                        const auto greater = detail::lower_bound_formatted(events, s, true);
+                        const auto earliest = (detail::time_point::min)();
+                        const auto latest = (detail::time_point::max)();
+                        add(property,
+                            U("lt") == op ? detail::find_timestamps(events, earliest, not_less) :
+                            U("le") == op ? detail::find_timestamps(events, earliest, greater) :
+                            U("gt") == op ? detail::find_timestamps(events, greater, latest) :
+                            U("ge") == op ? detail::find_timestamps(events, not_less, latest) :
+                            detail::find_timestamps(events, not_less, greater));
+                    }
+                    else if (detail::is_route_parameter(property, name))
+                    {
+                        const rql::compiled_query match(term);
+                        const auto range = detail::equal_name_range(events.route_parameters(), utility::us2s(name));
+                        add(property, detail::find_keys(events.route_parameters(), range.first, range.second, [&match, &name](const std::pair<std::string, std::string>& key) -> bool
+                        {
+                            return rql::value_true == match(detail::make_field(U("route_parameters"), detail::make_field(name, detail::json_from_string(key.second))).as_object());
+                        }));
+                    }
+                    else
+                    {
+                        plan.exact = false;
+                    }
+                }
+            }
+
+            if (!found.empty())
+            {
+                plan.indexed = true;
+
+                // start from the fewest candidates
+                std::sort(found.begin(), found.end(), [](const detail::sequences& lhs, const detail::sequences& rhs) { return lhs.size() < rhs.size(); });
+                plan.candidates.swap(found.front());
+                for (auto it = std::next(found.begin()); found.end() != it && !plan.candidates.empty(); ++it)
+                {
+                    detail::sequences intersection;
+                    std::set_intersection(plan.candidates.begin(), plan.candidates.end(), it->begin(), it->end(), std::back_inserter(intersection));
+                    plan.candidates.swap(intersection);
+                }
+            }
+
+            return plan;
+        }
+
+        utility::string_t log_events_query_plan::description() const
+        {
+            if (!indexed) return U("scan");
+            utility::string_t result(U("index("));
+            for (auto it = fields.begin(); fields.end() != it; ++it)
+            {
+                if (fields.begin() != it) result.push_back(U(','));
+                result.append(*it);
+            }
+            result.push_back(U(')'));
+            return result;
+        }
+    }
+}
@@ -0,0 +1,184 @@
+#ifndef NMOS_LOG_MODEL_H
+#define NMOS_LOG_MODEL_H
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "cpprest/json_utils.h"
+#include "nmos/id.h"
+#include "nmos/slog.h" // for slog::async_log_message
+#include "rql/rql.h"
+
+// This is an experimental extension to expose logging via a REST API
+namespace nmos
+{
+    namespace experimental
+    {
+        // Log events are stored compactly, as fixed-size records in a ring, with their strings in a ring of bytes, so that
+        // a large number of events can be retained in a fixed amount of memory, and are only converted to json when they
+        // are served by the Logging API
+        // The indices add the cost of a sequence number per event for each indexed value (the level, and any HTTP method
+        // and route parameters), and one copy of each distinct value
+        // Each event has a sequence number, which increases by one for every event, and from which its id is derived,
+        // so that an event can be found by its id without an index
+        struct log_event_record
+        {
+            // the strings, in the order they are stored
+            enum string_field { file, function, message, http_method, request_uri, route_parameters, string_field_count };
+
+            slog::async_log_message::time_point timestamp;
+            bst::thread::id thread_id;
+            slog::severity level;
+            int line;
+
+            // the position of the event's strings in the string ring, and the length of each one (in UTF-8)
+            // the route parameters are stored as a sequence of null-terminated names and values
+            std::uint64_t strings;
+            std::uint32_t lengths[string_field_count];
+        };
+
+        class log_events
+        {
+        public:
+            // the string ring is sized to allow for the specified average number of bytes per event
+            static const std::size_t default_average_size = 256;
+
+            explicit log_events(std::size_t capacity = 1234, std::size_t average_size = default_average_size);
+
+            // change the maximum number of events, keeping as many of the most recent events as possible
+            void set_capacity(std::size_t capacity, std::size_t average_size = default_average_size);
+            std::size_t capacity() const { return records.size(); }
+
+            std::size_t size() const { return static_cast<std::size_t>(end_sequence_ - begin_sequence_); }
+            bool empty() const { return begin_sequence_ == end_sequence_; }
+
+            // append an event, discarding the oldest events if necessary to make space for it
+            void push_back(const slog::async_log_message& message);
+
+            // discard all the events (sequence numbers and ids are not reused)
+            void clear();
+
+            // the sequence numbers of the events held are in the half-open range [begin_sequence(), end_sequence())
+            std::uint64_t begin_sequence() const { return begin_sequence_; }
+            std::uint64_t end_sequence() const { return end_sequence_; }
+
+            // get the record of the event with the specified sequence number, which must be held
+            const log_event_record& at(std::uint64_t sequence) const { return records[sequence % records.size()]; }
+
+            // get the sequence number of the event with the specified id, or end_sequence() if it isn't held
+            std::uint64_t find(const nmos::id& id) const;
+
+            // get the specified string of the event with the specified sequence number
+            // (the second form reuses the capacity of the result)
+            std::string get_string(std::uint64_t sequence, log_event_record::string_field field) const;
+            void get_string(std::uint64_t sequence, log_event_record::string_field field, std::string& result) const;
+
+            // get the id of the event with the specified sequence number
+            nmos::id event_id(std::uint64_t sequence) const;
+
+            // construct the json representation of the event with the specified sequence number
+            web::json::value json(std::uint64_t sequence) const;
+
+            // secondary indices from the distinct values of the commonly queried fields to the sequence numbers of the events,
+            // in sequence order, so that evicting the oldest event just pops the front of each of its values' sequences
+            // (timestamps aren't indexed, since they are almost all distinct, and the records can be scanned for a range)
+            typedef std::deque<std::uint64_t> sequences;
+            typedef std::map<slog::severity, sequences> level_index;
+            typedef std::map<std::string, sequences> http_method_index;
+            typedef std::map<std::pair<std::string, std::string>, sequences> route_parameter_index;
+
+            const level_index& levels() const { return levels_; }
+            // only events with a stashed HTTP method are indexed
+            const http_method_index& http_methods() const { return http_methods_; }
+            // keyed on the name and value of each stashed route parameter
+            const route_parameter_index& route_parameters() const { return route_parameters_; }
+
+        private:
+            void pop_front();
+            std::uint64_t push_string(const char* data, std::size_t size);
+
+            void insert_indices(std::uint64_t sequence);
+            void erase_indices(std::uint64_t sequence);
+
+            std::vector<log_event_record> records;
+            std::uint64_t begin_sequence_;
+            std::uint64_t end_sequence_;
+
+            std::vector<char> strings;
+            std::uint64_t begin_strings;
+            std::uint64_t end_strings;
+
+            // event ids are formed from this random (version 4) UUID, with the sequence number in the last 6 bytes
+            compact_id id_base;
+
+            level_index levels_;
+            http_method_index http_methods_;
+            route_parameter_index route_parameters_;
+
+            // reused to look up the indices, so that pushing and evicting events doesn't usually allocate for that
+            std::string scratch_string;
+            std::pair<std::string, std::string> scratch_key;
+        };
+
+        struct log_model
+        {
+            log_events events;
+        };
+
+        // push a log event into the model keeping a maximum size (lock the mutex before calling this)
+        void log_to_model(log_model& model, const slog::async_log_message& message);
+
+        // Predicate to match log events against a query, e.g. "?level=..." or "?query.rql=...", compiled once per request
+        // rather than for every event
+        // Basic queries match case-insensitive substrings
+        struct log_events_query
+        {
+            typedef const web::json::value& argument_type;
+            typedef bool result_type;
+
+            // basic_query is the unflattened query parameters other than paging and advanced query options
+            // rql_query is the parsed RQL query, or null
+            log_events_query(const web::json::value& basic_query, const web::json::value& rql_query);
+
+            // whether there are any terms, otherwise every event matches
+            bool filtered() const { return 0 != basic_query.size() || !rql_query.is_null(); }
+
+            result_type operator()(argument_type event) const;
+
+            web::json::value basic_query;
+            web::json::value rql_query;
+            web::json::match_flag_type match_flags;
+            web::json::query_matcher basic_matcher;
+            rql::compiled_query rql_matcher;
+        };
+
+        // A query plan determines the candidate events for a query using the indices of the log events where possible,
+        // e.g. for "?http_method=POST" or "?query.rql=ge(level,10)", so that only those candidates need to be matched
+        // against the whole query, or none of them if the indices satisfy every term
+        struct log_events_query_plan
+        {
+            log_events_query_plan() : indexed(false), exact(true) {}
+
+            // whether the candidates were found using the indices, otherwise every event is a candidate
+            bool indexed;
+            // the candidates in sequence order
+            std::vector<std::uint64_t> candidates;
+            // whether the candidates are exactly the matching events, so they needn't be matched against the query
+            bool exact;
+            // the indexed fields
+            std::vector<utility::string_t> fields;
+
+            // a short description, e.g. "scan" or "index(level,http_method)"
+            utility::string_t description() const;
+        };
+
+        // choose the plan for a query, from the basic query fields and the top-level terms of the RQL query, i.e. comparisons
+        // of level, timestamp, http_method or route_parameters with a literal, including those of an and, and find the candidates
+        log_events_query_plan plan_log_events_query(const log_events& events, const log_events_query& query);
+    }
+}
+
+#endif
@@ -8,7 +8,7 @@ namespace nmos
 {
     namespace experimental
     {
-        web::http::experimental::listener::api_router make_logging_api(nmos::experimental::log_model& model, std::mutex& mutex, slog::base_gate& gate)
+        web::http::experimental::listener::api_router make_logging_api(nmos::experimental::log_model& model, std::mutex& mutex, web::http::streamed_reply_pool& streamed_replies, slog::base_gate& gate)
         {
             using namespace web::http::experimental::listener::api_router_using_declarations;
 
@@ -26,10 +26,8 @@ namespace nmos
                 return true;
             });
 
-            logging_api.support(U("/log/events/?"), methods::GET, [&model, &mutex, &gate](const http_request& req, http_response& res, const string_t&, const route_parameters& parameters)
+            logging_api.support(U("/log/events/?"), methods::GET, [&model, &mutex, &streamed_replies, &gate](const http_request& req, http_response& res, const string_t&, const route_parameters& parameters)
             {
-                std::lock_guard<std::mutex> lock(mutex);
-
                 auto flat_query_params = web::json::value_from_query(req.request_uri().query());
                 for (auto& param : flat_query_params.as_object())
                 {
@@ -58,31 +56,58 @@ namespace nmos
                     }
                     basic_query.erase(U("query"));
                 }
+                const nmos::experimental::log_events_query match(basic_query, rql_query);
 
-                auto paged = nmos::paged<event>(
-                    [&basic_query, &rql_query](const event& event)
+                // construct the matching events, so that the response body can be streamed without holding the lock
+                auto matching = std::make_shared<std::vector<web::json::value>>();
+                size_t count = 0;
+                utility::string_t plan_description;
+
+                // nothing must be logged while holding the lock, since messages are written to the log model under it
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+
+                    const auto plan = nmos::experimental::plan_log_events_query(model.events, match);
+
+                    // events are only converted to json if they have to be matched, or once they are known to be in the page
+                    web::json::value data;
+
+                    auto paged = nmos::paged<std::uint64_t>(
+                        [&model, &match, &plan, &data](std::uint64_t sequence) -> bool
+                        {
+                            if (plan.exact) return true;
+                            data = model.events.json(sequence);
+                            return match(data);
+                        },
+                        offset, limit);
+                    const auto visit = [&model, &plan, &paged, &data, &matching](std::uint64_t sequence)
                     {
-                        return web::json::match_query(event.data, basic_query, web::json::match_icase | web::json::match_substr)
-                            && rql_query.is_null() || rql::evaluator
-                            {
-                                [&event](web::json::value& results, const web::json::value& key)
-                                {
-                                    return web::json::extract(event.data.as_object(), results, key.as_string());
-                                },
-                                rql::default_any_operators()
-                            }(rql_query) == web::json::value::boolean(true);
-                    },
-                    offset, limit);
-                size_t& count = paged.count;
+                        if (paged(sequence)) matching->push_back(plan.exact ? model.events.json(sequence) : std::move(data));
+                    };
+                    if (plan.indexed)
+                    {
+                        for (auto sequence : plan.candidates) visit(sequence);
+                    }
+                    else
+                    {
+                        for (auto sequence = model.events.begin_sequence(); model.events.end_sequence() != sequence; ++sequence) visit(sequence);
+                    }
+
+                    count = paged.count;
+                    plan_description = plan.description();
+                }
 
-                set_reply(res, status_codes::OK,
-                    web::json::serialize_if(model.events,
-                        std::ref(paged), // to ensure count is updated
-                        [](const event& event){ return event.data; }),
+                set_streamed_reply(res, status_codes::OK,
+                    [matching](utility::ostream_t& os)
+                    {
+                        web::json::serialize(os, *matching, [](const web::json::value& data) -> const web::json::value& { return data; });
+                    },
+                    streamed_replies,
                     U("application/json"));
                 res.headers().add(U("X-Total-Count"), count);
+                res.headers().add(nmos::experimental::header_names::query_plan, plan_description);
 
-                slog::log<slog::severities::too_much_info>(gate, SLOG_FLF) << nmos::api_stash(req, parameters) << "Returning " << (count < offset ? 0 : count < offset + limit ? count - offset : limit) << " matching log events";
+                slog::log<slog::severities::too_much_info>(gate, SLOG_FLF) << nmos::api_stash(req, parameters) << "Returning " << (count < offset ? 0 : count < offset + limit ? count - offset : limit) << " matching log events using query plan " << plan_description;
 
                 return true;
             });
@@ -110,13 +135,10 @@ namespace nmos
 
                 const string_t eventId = parameters.at(nmos::patterns::resourceId.name);
 
-                typedef events::index<tags::id>::type by_id;
-                by_id& ids = model.events.get<tags::id>();
-
-                auto event = ids.find(eventId);
-                if (ids.end() != event)
+                const auto sequence = model.events.find(eventId);
+                if (model.events.end_sequence() != sequence)
                 {
-                    set_reply(res, status_codes::OK, event->data);
+                    set_reply(res, status_codes::OK, model.events.json(sequence));
                 }
                 else
                 {
@@ -130,57 +152,5 @@ namespace nmos
 
             return logging_api;
         }
-
-        namespace detail
-        {
-            inline web::json::value json_from_string(const std::string& s)
-            {
-                return web::json::value{ utility::s2us(s) };
-            }
-
-            template <typename T>
-            inline std::string ostringstreamed(const T& value)
-            {
-                return [&]{ std::ostringstream os; os << value; return os.str(); }();
-            }
-
-            inline web::json::value json_from_message(const slog::async_log_message& message)
-            {
-                web::json::value json_source_location = web::json::value::object(true);
-                json_source_location[U("file")] = json_from_string(message.file());
-                json_source_location[U("line")] = message.line();
-                json_source_location[U("function")] = json_from_string(message.function());
-
-                web::json::value json_message = web::json::value::object(true);
-                json_message[U("timestamp")] = json_from_string(ostringstreamed(slog::put_timestamp(message.timestamp(), "%Y-%m-%dT%H:%M:%06.3SZ")));
-                json_message[U("level")] = message.level();
-                json_message[U("level_name")] = json_from_string(ostringstreamed(slog::put_severity_name(message.level())));
-                json_message[U("thread_id")] = json_from_string(ostringstreamed(message.thread_id()));
-                json_message[U("source_location")] = json_source_location;
-                json_message[U("message")] = json_from_string(message.str());
-
-                const auto http_method = nmos::get_http_method_stash(message.stream());
-                if (!http_method.empty()) json_message[U("http_method")] = web::json::value::string(http_method);
-                const auto request_uri = nmos::get_request_uri_stash(message.stream());
-                if (!request_uri.is_empty()) json_message[U("request_uri")] = web::json::value::string(request_uri.to_string());
-                const auto route_parameters = nmos::get_route_parameters_stash(message.stream());
-                if (!route_parameters.empty()) json_message[U("route_parameters")] = web::json::value_from_fields(route_parameters);
-
-                // adding an id just to allow the API to provide access to single events in the standard REST manner
-                json_message[U("id")] = web::json::value::string(nmos::make_id());
-                return json_message;
-            }
-        }
-
-        void log_to_model(log_model& model, const slog::async_log_message& message)
-        {
-            // capacity ought to be part of log/settings
-            const std::size_t capacity = 1234;
-            while (model.events.size() > capacity)
-            {
-                model.events.pop_front();
-            }
-            model.events.push_back({ detail::json_from_message(message) });
-        }
     }
 }
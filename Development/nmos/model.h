@@ -11,7 +11,16 @@ namespace nmos
     {
         resources resources;
         settings settings;
+
+        // the latest snapshot of the resources, see get_resources_snapshot
+        resources_snapshot snapshot;
     };
+
+    // get a snapshot of the model resources, while holding the lock on the model
+    inline resources_snapshot get_resources_snapshot(model& model)
+    {
+        return get_resources_snapshot(model.snapshot, model.resources);
+    }
 }
 
 #endif
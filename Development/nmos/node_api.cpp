@@ -7,9 +7,9 @@
 
 namespace nmos
 {
-    web::http::experimental::listener::api_router make_unmounted_node_api(nmos::resources& resources, std::mutex & mutex, slog::base_gate& gate);
+    web::http::experimental::listener::api_router make_unmounted_node_api(nmos::resources& resources, std::mutex& mutex, web::http::streamed_reply_pool& streamed_replies, slog::base_gate& gate);
 
-    web::http::experimental::listener::api_router make_node_api(nmos::resources& resources, std::mutex& mutex, slog::base_gate& gate)
+    web::http::experimental::listener::api_router make_node_api(nmos::resources& resources, std::mutex& mutex, web::http::streamed_reply_pool& streamed_replies, slog::base_gate& gate)
     {
         using namespace web::http::experimental::listener::api_router_using_declarations;
 
@@ -33,14 +33,14 @@ namespace nmos
             return true;
         });
 
-        node_api.mount(U("/x-nmos/") + nmos::patterns::node_api.pattern + U("/") + nmos::patterns::is04_version.pattern, make_unmounted_node_api(resources, mutex, gate));
+        node_api.mount(U("/x-nmos/") + nmos::patterns::node_api.pattern + U("/") + nmos::patterns::is04_version.pattern, make_unmounted_node_api(resources, mutex, streamed_replies, gate));
 
         nmos::add_api_finally_handler(node_api, gate);
 
         return node_api;
     }
 
-    web::http::experimental::listener::api_router make_unmounted_node_api(nmos::resources& resources, std::mutex& mutex, slog::base_gate& gate)
+    web::http::experimental::listener::api_router make_unmounted_node_api(nmos::resources& resources, std::mutex& mutex, web::http::streamed_reply_pool& streamed_replies, slog::base_gate& gate)
     {
         using namespace web::http::experimental::listener::api_router_using_declarations;
 
@@ -58,11 +58,22 @@ namespace nmos
 
             const nmos::api_version version = nmos::parse_api_version(parameters.at(nmos::patterns::is04_version.name));
 
-            auto resource = std::find_if(resources.begin(), resources.end(), [](const nmos::resources::value_type& resource){ return nmos::types::node == resource.type; });
-            if (resources.end() != resource && nmos::is_permitted_downgrade(*resource, version))
+            auto nodes = get_resources_of_type(resources, nmos::types::node);
+            auto resource = nodes.begin();
+            if (nodes.end() != resource && nmos::is_permitted_downgrade(*resource, version))
             {
-                slog::log<slog::severities::more_info>(gate, SLOG_FLF) << nmos::api_stash(req, parameters) << "Returning self resource: " << resource->id;
-                set_reply(res, status_codes::OK, nmos::downgrade(*resource, version));
+                const auto entity_tag = nmos::make_resources_entity_tag(req, resource->updated);
+                if (web::http::match_if_none_match(req, entity_tag))
+                {
+                    slog::log<slog::severities::more_info>(gate, SLOG_FLF) << nmos::api_stash(req, parameters) << "Self resource not modified: " << nmos::fields::id(*resource->data);
+                    set_reply(res, status_codes::NotModified);
+                }
+                else
+                {
+                    slog::log<slog::severities::more_info>(gate, SLOG_FLF) << nmos::api_stash(req, parameters) << "Returning self resource: " << nmos::fields::id(*resource->data);
+                    set_reply(res, status_codes::OK, nmos::downgrade(*resource, version));
+                }
+                res.headers().add(web::http::header_names::etag, entity_tag);
             }
             else
             {
@@ -73,24 +84,46 @@ namespace nmos
             return true;
         });
 
-        node_api.support(U("/") + nmos::patterns::subresourceType.pattern + U("/?"), methods::GET, [&resources, &mutex, &gate](const http_request& req, http_response& res, const string_t&, const route_parameters& parameters)
+        // the latest snapshot of the resources, so that the response body can be streamed without holding the lock
+        auto latest = std::make_shared<nmos::resources_snapshot>();
+
+        node_api.support(U("/") + nmos::patterns::subresourceType.pattern + U("/?"), methods::GET, [&resources, &mutex, &streamed_replies, &gate, latest](const http_request& req, http_response& res, const string_t&, const route_parameters& parameters)
         {
-            std::lock_guard<std::mutex> lock(mutex);
+            nmos::resources_snapshot snapshot;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                snapshot = nmos::get_resources_snapshot(*latest, resources);
+            }
+
+            const auto entity_tag = nmos::make_resources_entity_tag(req, snapshot.most_recent_update, snapshot.size);
+            if (web::http::match_if_none_match(req, entity_tag))
+            {
+                slog::log<slog::severities::more_info>(gate, SLOG_FLF) << nmos::api_stash(req, parameters) << "Not modified since snapshot generation " << snapshot.generation;
+                set_reply(res, status_codes::NotModified);
+                res.headers().add(web::http::header_names::etag, entity_tag);
+                return true;
+            }
 
             const nmos::api_version version = nmos::parse_api_version(parameters.at(nmos::patterns::is04_version.name));
             const string_t resourceType = parameters.at(nmos::patterns::subresourceType.name);
 
-            const auto match = [&](const nmos::resources::value_type& resource) { return resource.type == nmos::type_from_resourceType(resourceType) && nmos::is_permitted_downgrade(resource, version); };
-
-            size_t count = 0;
+            auto matching = std::make_shared<std::vector<const nmos::resource*>>();
+            for (const auto& resource : get_resources_of_type(*snapshot.resources, nmos::type_from_resourceType(resourceType)))
+            {
+                if (nmos::is_permitted_downgrade(resource, version)) matching->push_back(&resource);
+            }
 
-            set_reply(res, status_codes::OK,
-                web::json::serialize_if(resources,
-                    match,
-                    [&count, &version](const nmos::resources::value_type& resource) { ++count; return nmos::downgrade(resource, version); }),
+            auto snapshot_resources = snapshot.resources;
+            set_streamed_reply(res, status_codes::OK,
+                [snapshot_resources, matching, version](utility::ostream_t& os)
+                {
+                    nmos::serialize_downgrade(os, *matching, version);
+                },
+                streamed_replies,
                 U("application/json"));
+            res.headers().add(web::http::header_names::etag, entity_tag);
 
-            slog::log<slog::severities::info>(gate, SLOG_FLF) << nmos::api_stash(req, parameters) << "Returning " << count << " matching " << resourceType;
+            slog::log<slog::severities::info>(gate, SLOG_FLF) << nmos::api_stash(req, parameters) << "Returning " << matching->size() << " matching " << resourceType;
 
             return true;
         });
@@ -108,8 +141,18 @@ namespace nmos
             {
                 if (resource->type == nmos::type_from_resourceType(resourceType) && nmos::is_permitted_downgrade(*resource, version))
                 {
-                    slog::log<slog::severities::more_info>(gate, SLOG_FLF) << nmos::api_stash(req, parameters) << "Returning resource: " << resourceId;
-                    set_reply(res, status_codes::OK, nmos::downgrade(*resource, version));
+                    const auto entity_tag = nmos::make_resources_entity_tag(req, resource->updated);
+                    if (web::http::match_if_none_match(req, entity_tag))
+                    {
+                        slog::log<slog::severities::more_info>(gate, SLOG_FLF) << nmos::api_stash(req, parameters) << "Resource not modified: " << resourceId;
+                        set_reply(res, status_codes::NotModified);
+                    }
+                    else
+                    {
+                        slog::log<slog::severities::more_info>(gate, SLOG_FLF) << nmos::api_stash(req, parameters) << "Returning resource: " << resourceId;
+                        set_reply(res, status_codes::OK, nmos::downgrade(*resource, version));
+                    }
+                    res.headers().add(web::http::header_names::etag, entity_tag);
                 }
                 else
                 {
@@ -10,11 +10,19 @@ namespace slog
     class base_gate;
 }
 
+namespace web
+{
+    namespace http
+    {
+        class streamed_reply_pool;
+    }
+}
+
 // Node API implementation
 // See https://github.com/AMWA-TV/nmos-discovery-registration/blob/v1.2-dev/APIs/NodeAPI.raml
 namespace nmos
 {
-    web::http::experimental::listener::api_router make_node_api(nmos::resources& resources, std::mutex& mutex, slog::base_gate& gate);
+    web::http::experimental::listener::api_router make_node_api(nmos::resources& resources, std::mutex& mutex, web::http::streamed_reply_pool& streamed_replies, slog::base_gate& gate);
 }
 
 #endif
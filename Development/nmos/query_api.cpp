@@ -8,9 +8,9 @@
 
 namespace nmos
 {
-    inline web::http::experimental::listener::api_router make_unmounted_query_api(nmos::model& model, std::mutex& mutex, slog::base_gate& gate);
+    inline web::http::experimental::listener::api_router make_unmounted_query_api(nmos::model& model, std::mutex& mutex, web::http::streamed_reply_pool& streamed_replies, slog::base_gate& gate);
 
-    web::http::experimental::listener::api_router make_query_api(nmos::model& model, std::mutex& mutex, slog::base_gate& gate)
+    web::http::experimental::listener::api_router make_query_api(nmos::model& model, std::mutex& mutex, web::http::streamed_reply_pool& streamed_replies, slog::base_gate& gate)
     {
         using namespace web::http::experimental::listener::api_router_using_declarations;
 
@@ -34,14 +34,45 @@ namespace nmos
             return true;
         });
 
-        query_api.mount(U("/x-nmos/") + nmos::patterns::query_api.pattern + U("/") + nmos::patterns::is04_version.pattern, make_unmounted_query_api(model, mutex, gate));
+        query_api.mount(U("/x-nmos/") + nmos::patterns::query_api.pattern + U("/") + nmos::patterns::is04_version.pattern, make_unmounted_query_api(model, mutex, streamed_replies, gate));
 
         nmos::add_api_finally_handler(query_api, gate);
 
         return query_api;
     }
 
-    inline web::http::experimental::listener::api_router make_unmounted_query_api(nmos::model& model, std::mutex& mutex, slog::base_gate& gate)
+    // add the paging headers, with links to the previous, next, first and last pages, based on the request URI
+    // (other query parameters are preserved, and the links are relative to the request URI)
+    inline void add_paging_headers(web::http::http_headers& headers, const resource_paging& paging, const web::uri& request_uri)
+    {
+        utility::string_t base = request_uri.path() + U('?');
+        const auto query = request_uri.query();
+        for (utility::string_t::size_type begin = 0, end = 0; utility::string_t::npos != end && begin < query.size(); begin = end + 1)
+        {
+            end = query.find(U('&'), begin);
+            const auto param = query.substr(begin, utility::string_t::npos != end ? end - begin : utility::string_t::npos);
+            if (param.empty() || 0 == param.find(U("paging.since=")) || 0 == param.find(U("paging.until=")) || 0 == param.find(U("paging.limit="))) continue;
+            base += param + U('&');
+        }
+        base += U("paging.limit=") + utility::ostringstreamed(paging.limit);
+
+        const auto link = [&base](const utility::string_t& paging, const utility::string_t& rel)
+        {
+            return U("<") + base + paging + U(">; rel=\"") + rel + U("\"");
+        };
+
+        headers.add(nmos::header_names::link,
+            link(U("&paging.until=") + nmos::make_version(paging.since), U("prev")) + U(", ") +
+            link(U("&paging.since=") + nmos::make_version(paging.until), U("next")) + U(", ") +
+            link(U("&paging.since=") + nmos::make_version(nmos::tai{}), U("first")) + U(", ") +
+            link(U(""), U("last")));
+
+        headers.add(nmos::header_names::paging_limit, paging.limit);
+        headers.add(nmos::header_names::paging_since, nmos::make_version(paging.since));
+        headers.add(nmos::header_names::paging_until, nmos::make_version(paging.until));
+    }
+
+    inline web::http::experimental::listener::api_router make_unmounted_query_api(nmos::model& model, std::mutex& mutex, web::http::streamed_reply_pool& streamed_replies, slog::base_gate& gate)
     {
         using namespace web::http::experimental::listener::api_router_using_declarations;
 
@@ -53,9 +84,28 @@ namespace nmos
             return true;
         });
 
-        query_api.support(U("/") + nmos::patterns::queryType.pattern + U("/?"), methods::GET, [&model, &mutex, &gate](const http_request& req, http_response& res, const string_t&, const route_parameters& parameters)
+        query_api.support(U("/") + nmos::patterns::queryType.pattern + U("/?"), methods::GET, [&model, &mutex, &streamed_replies, &gate](const http_request& req, http_response& res, const string_t&, const route_parameters& parameters)
         {
-            std::lock_guard<std::mutex> lock(mutex);
+            // only hold the lock long enough to get a snapshot of the resources, so that registrations and heartbeats aren't blocked
+            // while the response is generated
+            nmos::resources_snapshot snapshot;
+            size_t paging_default, paging_limit;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                snapshot = nmos::get_resources_snapshot(model);
+                paging_default = (size_t)nmos::fields::query_paging_default(model.settings);
+                paging_limit = (size_t)nmos::fields::query_paging_limit(model.settings);
+            }
+
+            // a client that already has the response for this query from an unchanged snapshot doesn't need it again
+            const auto entity_tag = nmos::make_resources_entity_tag(req, snapshot.most_recent_update, snapshot.size);
+            if (web::http::match_if_none_match(req, entity_tag))
+            {
+                slog::log<slog::severities::more_info>(gate, SLOG_FLF) << nmos::api_stash(req, parameters) << "Not modified since snapshot generation " << snapshot.generation;
+                set_reply(res, status_codes::NotModified);
+                res.headers().add(web::http::header_names::etag, entity_tag);
+                return true;
+            }
 
             const nmos::api_version version = nmos::parse_api_version(parameters.at(nmos::patterns::is04_version.name));
             const string_t resourceType = parameters.at(nmos::patterns::queryType.name);
@@ -73,15 +123,50 @@ namespace nmos
 
             slog::log<slog::severities::more_info>(gate, SLOG_FLF) << nmos::api_stash(req, parameters) << "Querying " << resourceType;
 
-            size_t count = 0;
+            // use the indices to find the candidate resources where possible, rather than matching every resource
+            const auto plan = nmos::plan_resource_query(match);
+
+            // the matching resources are found up front, but the response body is streamed from the snapshot
+            auto matching = std::make_shared<std::vector<const nmos::resource*>>();
+
+            // paging is only supported from v1.1
+            if (nmos::is04_versions::v1_1 <= version)
+            {
+                resource_paging paging(flat_query_params, snapshot.most_recent_update, paging_default, paging_limit);
+                if (!paging.valid())
+                {
+                    set_reply(res, status_codes::BadRequest);
+                    return true;
+                }
+
+                // paging without a selective plan uses the index of the paging order rather than the candidates
+                *matching = plan.selective()
+                    ? paging.page(nmos::get_candidate_resources(*snapshot.resources, plan), match)
+                    : paging.page(*snapshot.resources, match);
 
-            set_reply(res, status_codes::OK,
-                web::json::serialize_if(model.resources,
-                    match,
-                    [&count, &version](const nmos::resources::value_type& resource) { ++count; return nmos::downgrade(resource, version); }),
+                add_paging_headers(res.headers(), paging, req.request_uri());
+            }
+            else
+            {
+                for (auto resource : nmos::get_candidate_resources(*snapshot.resources, plan))
+                {
+                    if (match(*resource)) matching->push_back(resource);
+                }
+            }
+
+            auto snapshot_resources = snapshot.resources;
+            set_streamed_reply(res, status_codes::OK,
+                [snapshot_resources, matching, version](utility::ostream_t& os)
+                {
+                    nmos::serialize_downgrade(os, *matching, version);
+                },
+                streamed_replies,
                 U("application/json"));
+            res.headers().add(web::http::header_names::etag, entity_tag);
+            res.headers().add(nmos::experimental::header_names::resources_generation, snapshot.generation);
+            res.headers().add(nmos::experimental::header_names::query_plan, plan.description());
 
-            slog::log<slog::severities::info>(gate, SLOG_FLF) << nmos::api_stash(req, parameters) << "Returning " << count << " matching " << resourceType;
+            slog::log<slog::severities::info>(gate, SLOG_FLF) << nmos::api_stash(req, parameters) << "Returning " << matching->size() << " matching " << resourceType << " from snapshot generation " << snapshot.generation << " using query plan " << plan.description();
 
             return true;
         });
@@ -99,8 +184,18 @@ namespace nmos
             {
                 if (resource->type == nmos::type_from_resourceType(resourceType) && nmos::is_permitted_downgrade(*resource, version))
                 {
-                    slog::log<slog::severities::more_info>(gate, SLOG_FLF) << nmos::api_stash(req, parameters) << "Returning resource: " << resourceId;
-                    set_reply(res, status_codes::OK, nmos::downgrade(*resource, version));
+                    const auto entity_tag = nmos::make_resources_entity_tag(req, resource->updated);
+                    if (web::http::match_if_none_match(req, entity_tag))
+                    {
+                        slog::log<slog::severities::more_info>(gate, SLOG_FLF) << nmos::api_stash(req, parameters) << "Resource not modified: " << resourceId;
+                        set_reply(res, status_codes::NotModified);
+                    }
+                    else
+                    {
+                        slog::log<slog::severities::more_info>(gate, SLOG_FLF) << nmos::api_stash(req, parameters) << "Returning resource: " << resourceId;
+                        set_reply(res, status_codes::OK, nmos::downgrade(*resource, version));
+                    }
+                    res.headers().add(web::http::header_names::etag, entity_tag);
                 }
                 else
                 {
@@ -165,19 +260,20 @@ namespace nmos
                 }
 
                 // search for a matching existing subscription
-                resources::iterator resource = std::find_if(model.resources.begin(), model.resources.end(), [&req_host, &version, &data](const resources::value_type& resource)
+                auto subscriptions = get_resources_of_type(model.resources, nmos::types::subscription);
+                auto subscription = std::find_if(subscriptions.begin(), subscriptions.end(), [&req_host, &version, &data](const resources::value_type& resource)
                 {
                     return version == resource.version
-                        && nmos::types::subscription == resource.type
-                        && nmos::fields::max_update_rate_ms(data) == nmos::fields::max_update_rate_ms(resource.data)
-                        && nmos::fields::persist(data) == nmos::fields::persist(resource.data)
-                        && (nmos::is04_versions::v1_0 == version || nmos::fields::secure(data) == nmos::fields::secure(resource.data))
-                        && nmos::fields::resource_path(data) == nmos::fields::resource_path(resource.data)
-                        && nmos::fields::params(data) == nmos::fields::params(resource.data)
+                        && nmos::fields::max_update_rate_ms(data) == nmos::fields::max_update_rate_ms(*resource.data)
+                        && nmos::fields::persist(data) == nmos::fields::persist(*resource.data)
+                        && (nmos::is04_versions::v1_0 == version || nmos::fields::secure(data) == nmos::fields::secure(*resource.data))
+                        && nmos::fields::resource_path(data) == nmos::fields::resource_path(*resource.data)
+                        && nmos::fields::params(data) == nmos::fields::params(*resource.data)
                         // and finally, a matching subscription must be being served via the same interface as this request
                         // (which, let's approximate by checking the host matches)
-                        && req_host == web::uri(nmos::fields::ws_href(resource.data)).host();
+                        && req_host == web::uri(nmos::fields::ws_href(*resource.data)).host();
                 });
+                resources::iterator resource = subscriptions.end() != subscription ? model.resources.project<0>(subscription) : model.resources.end();
                 const bool creating = model.resources.end() == resource;
 
                 if (creating)
@@ -204,7 +300,7 @@ namespace nmos
                 {
                     // just return the existing subscription
                     // downgrade doesn't apply to subscriptions; at this point, version must be equal to resource->version
-                    data = resource->data;
+                    data = *resource->data;
                 }
 
                 set_reply(res, creating ? status_codes::Created : status_codes::OK, data);
@@ -232,7 +328,7 @@ namespace nmos
                 // downgrade doesn't apply to subscriptions; at this point, version must be equal to subscription->version
                 if (subscription->type == nmos::types::subscription && subscription->version == version)
                 {
-                    if (nmos::fields::persist(subscription->data))
+                    if (nmos::fields::persist(*subscription->data))
                     {
                         slog::log<slog::severities::info>(gate, SLOG_FLF) << nmos::api_stash(req, parameters) << "Deleting subscription: " << subscriptionId;
                         erase_resource(model.resources, subscription->id);
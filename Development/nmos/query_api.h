@@ -9,13 +9,21 @@ namespace slog
     class base_gate;
 }
 
+namespace web
+{
+    namespace http
+    {
+        class streamed_reply_pool;
+    }
+}
+
 // Query API implementation
 // See https://github.com/AMWA-TV/nmos-discovery-registration/blob/v1.2-dev/APIs/QueryAPI.raml
 namespace nmos
 {
     struct model;
 
-    web::http::experimental::listener::api_router make_query_api(nmos::model& model, std::mutex& mutex, slog::base_gate& gate);
+    web::http::experimental::listener::api_router make_query_api(nmos::model& model, std::mutex& mutex, web::http::streamed_reply_pool& streamed_replies, slog::base_gate& gate);
 }
 
 #endif
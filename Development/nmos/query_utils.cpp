@@ -1,5 +1,6 @@
 #include "nmos/query_utils.h"
 
+#include <algorithm>
 #include <set>
 #include <boost/algorithm/string/split.hpp>
 #include "nmos/api_downgrade.h"
@@ -23,9 +24,63 @@ namespace nmos
         }
     }
 
+    resource_paging::resource_paging(const web::json::value& flat_query_params, const nmos::tai& max_until, size_t default_limit, size_t max_limit)
+        : order_by_created(true)
+        , since()
+        , until(max_until)
+        , limit(default_limit)
+        , since_specified(flat_query_params.has_field(U("paging.since")))
+        , until_specified(flat_query_params.has_field(U("paging.until")))
+        , valid_order(true)
+    {
+        if (flat_query_params.has_field(U("paging.order")))
+        {
+            const auto order = web::json::field_as_string{ U("paging.order") }(flat_query_params);
+            order_by_created = U("create") == order;
+            valid_order = order_by_created || U("update") == order;
+        }
+        // since or until values in the future are treated as the most recent update
+        if (since_specified)
+        {
+            since = (std::min)(nmos::parse_version(web::json::field_as_string{ U("paging.since") }(flat_query_params)), max_until);
+        }
+        if (until_specified)
+        {
+            until = (std::min)(nmos::parse_version(web::json::field_as_string{ U("paging.until") }(flat_query_params)), max_until);
+        }
+        if (flat_query_params.has_field(U("paging.limit")))
+        {
+            // a limit greater than the maximum is treated as the maximum
+            const auto requested = utility::istringstreamed<int>(web::json::field_as_string{ U("paging.limit") }(flat_query_params));
+            limit = (std::min)((size_t)(std::max)(requested, 0), max_limit);
+        }
+    }
+
+    // resource_path may be empty (matching all resource types) or e.g. "/nodes", which corresponds to a single type
+    static nmos::type type_from_resource_path(const utility::string_t& resource_path)
+    {
+        if (resource_path.empty() || U('/') != resource_path.front()) return nmos::types::unknown;
+        const utility::string_t resourceType = resource_path.substr(1);
+        try
+        {
+            const auto type = nmos::type_from_resourceType(resourceType);
+            // e.g. "/self" isn't a valid resource_path
+            return resourceType == nmos::resourceType_from_type(type) ? type : nmos::types::unknown;
+        }
+        catch (const std::out_of_range&)
+        {
+            return nmos::types::unknown;
+        }
+    }
+
+    // Extend RQL with some NMOS-specific types, see below
+    web::json::value equal_to(const web::json::value& lhs, const web::json::value& rhs);
+    web::json::value less(const web::json::value& lhs, const web::json::value& rhs);
+
     resource_query::resource_query(const nmos::api_version& version, const utility::string_t& resource_path, const web::json::value& flat_query_params)
         : version(version)
         , resource_path(resource_path)
+        , resource_type(type_from_resource_path(resource_path))
         , basic_query(web::json::unflatten(flat_query_params))
         , downgrade_version(version)
         , match_flags(web::json::match_default)
@@ -45,6 +100,7 @@ namespace nmos
             if (advanced.has_field(U("rql")))
             {
                 rql_query = rql::parse_query(web::json::field_as_string{ U("rql") }(advanced));
+                rql_matcher = rql::compiled_query(rql_query, equal_to, less);
             }
             // extract the experimental match flags, which extend Basic Queries with really simple per-query control of string matching
             if (advanced.has_field(U("match_type")))
@@ -53,6 +109,7 @@ namespace nmos
             }
             basic_query.erase(U("query"));
         }
+        basic_matcher = web::json::query_matcher(basic_query, match_flags);
     }
 
     // Extend RQL with some NMOS-specific types
@@ -109,24 +166,167 @@ namespace nmos
         return rql::value_indeterminate;
     }
 
-    bool match_rql(const web::json::value& value, const web::json::value& query)
+    bool match_rql(const web::json::value& value, const rql::compiled_query& query)
     {
-        return query.is_null() || rql::evaluator
-        {
-            [&value](web::json::value& results, const web::json::value& key)
-            {
-                return web::json::extract(value.as_object(), results, key.as_string());
-            },
-            rql::default_any_operators(equal_to, less)
-        }(query) == web::json::value::boolean(true);
+        return query(value.as_object()) == rql::value_true;
     }
 
     resource_query::result_type resource_query::operator()(const nmos::api_version& resource_version, const nmos::type& resource_type, const web::json::value& resource_data) const
     {
-        return (resource_path.empty() || resource_path == U('/') + nmos::resourceType_from_type(resource_type))
+        return (resource_path.empty() || (nmos::types::unknown != this->resource_type && this->resource_type == resource_type))
             && nmos::is_permitted_downgrade(resource_version, resource_type, version, downgrade_version)
-            && web::json::match_query(resource_data, basic_query, match_flags)
-            && match_rql(resource_data, rql_query);
+            && basic_matcher(resource_data)
+            && (rql_query.is_null() || match_rql(resource_data, rql_matcher));
+    }
+
+    // Query plans
+
+    // the field which identifies the super-resource of each type of resource, see nmos::get_super_resource
+    static std::pair<utility::string_t, nmos::type> get_super_resource_field(const nmos::type& type)
+    {
+        if (nmos::types::device == type) return{ U("node_id"), nmos::types::node };
+        else if (nmos::types::source == type) return{ U("device_id"), nmos::types::device };
+        else if (nmos::types::flow == type) return{ U("source_id"), nmos::types::source };
+        else if (nmos::types::sender == type) return{ U("device_id"), nmos::types::device };
+        else if (nmos::types::receiver == type) return{ U("device_id"), nmos::types::device };
+        else return{ utility::string_t{}, nmos::types::unknown };
+    }
+
+    // find the ids which a top-level term of a query requires the specified field to have, if any
+    static bool find_basic_query_ids(const resource_query& query, const utility::string_t& field, std::vector<nmos::id>& ids)
+    {
+        // case-insensitive or substring matches can't use an index
+        if (web::json::match_default != query.match_flags || !query.basic_query.has_field(field)) return false;
+        const auto& value = query.basic_query.at(field);
+        if (!value.is_string()) return false;
+        ids.assign(1, value.as_string());
+        return true;
+    }
+
+    static bool find_rql_query_ids(const web::json::value& term, const utility::string_t& field, std::vector<nmos::id>& ids)
+    {
+        if (!rql::is_call_operator(term)) return false;
+        const auto& name = term.at(U("name")).as_string();
+        const auto& args = term.at(U("args"));
+        if (!args.is_array() || 2 > args.size() || !args.at(0).is_string() || field != args.at(0).as_string()) return false;
+        const auto& arg = args.at(1);
+        if (U("eq") == name && arg.is_string())
+        {
+            ids.assign(1, arg.as_string());
+            return true;
+        }
+        else if (U("in") == name && arg.is_array())
+        {
+            std::vector<nmos::id> in_ids;
+            for (const auto& element : arg.as_array())
+            {
+                if (!element.is_string()) return false;
+                in_ids.push_back(element.as_string());
+            }
+            ids.swap(in_ids);
+            return true;
+        }
+        return false;
+    }
+
+    static bool find_query_ids(const resource_query& query, const utility::string_t& field, std::vector<nmos::id>& ids)
+    {
+        if (find_basic_query_ids(query, field, ids)) return true;
+        if (query.rql_query.is_null()) return false;
+
+        // every term of a top-level and must be satisfied, so any of them will do
+        if (rql::is_call_operator(query.rql_query) && U("and") == query.rql_query.at(U("name")).as_string())
+        {
+            const auto& args = query.rql_query.at(U("args"));
+            if (!args.is_array()) return false;
+            for (const auto& term : args.as_array())
+            {
+                if (find_rql_query_ids(term, field, ids)) return true;
+            }
+            return false;
+        }
+        return find_rql_query_ids(query.rql_query, field, ids);
+    }
+
+    resource_query_plan plan_resource_query(const resource_query& query)
+    {
+        resource_query_plan plan;
+
+        if (!query.resource_path.empty())
+        {
+            plan.index = resource_query_plan::scan_type;
+            plan.type = query.resource_type;
+        }
+
+        if (find_query_ids(query, U("id"), plan.ids))
+        {
+            plan.index = resource_query_plan::find_id;
+            plan.field = U("id");
+        }
+        else if (resource_query_plan::scan_type == plan.index)
+        {
+            const auto super_resource_field = get_super_resource_field(plan.type);
+            if (!super_resource_field.first.empty() && find_query_ids(query, super_resource_field.first, plan.ids))
+            {
+                plan.index = resource_query_plan::find_super_resource;
+                plan.super_type = super_resource_field.second;
+                plan.field = super_resource_field.first;
+            }
+        }
+
+        std::sort(plan.ids.begin(), plan.ids.end());
+        plan.ids.erase(std::unique(plan.ids.begin(), plan.ids.end()), plan.ids.end());
+
+        return plan;
+    }
+
+    utility::string_t resource_query_plan::description() const
+    {
+        switch (index)
+        {
+        case scan_type: return U("type(") + type.name() + U(")");
+        case find_id: return U("id");
+        case find_super_resource: return U("super_resource(") + field + U(")");
+        default: return U("scan");
+        }
+    }
+
+    std::vector<const nmos::resource*> get_candidate_resources(const nmos::resources& resources, const resource_query_plan& plan)
+    {
+        std::vector<const nmos::resource*> candidates;
+        switch (plan.index)
+        {
+        case resource_query_plan::find_id:
+            for (const auto& id : plan.ids)
+            {
+                auto found = resources.find(id);
+                if (resources.end() != found && (nmos::types::unknown == plan.type || plan.type == found->type)) candidates.push_back(&*found);
+            }
+            break;
+        case resource_query_plan::find_super_resource:
+            for (const auto& id : plan.ids)
+            {
+                for (const auto& resource : boost::make_iterator_range(resources.get<tags::super_resource>().equal_range(std::make_pair(compact_id(id), plan.super_type))))
+                {
+                    if (plan.type == resource.type) candidates.push_back(&resource);
+                }
+            }
+            break;
+        case resource_query_plan::scan_type:
+            for (const auto& resource : get_resources_of_type(resources, plan.type))
+            {
+                candidates.push_back(&resource);
+            }
+            break;
+        default:
+            candidates.reserve(resources.size());
+            for (const auto& resource : resources)
+            {
+                candidates.push_back(&resource);
+            }
+            break;
+        }
+        return candidates;
     }
 
     // Helpers for constructing /subscriptions websocket grains
@@ -151,15 +351,19 @@ namespace nmos
         using utility::string_t;
         using web::json::value;
 
-        for (const auto& subscription : resources)
+        for (const auto& subscription : get_resources_of_type(resources, nmos::types::subscription))
         {
             // for each subscription
-            if (nmos::types::subscription != subscription.type) continue;
 
             // check whether the resource_path matches the resource type and the query parameters match either the "pre" or "post" resource
+            // using the query which was compiled when the subscription was inserted
+
+            const auto& match = *subscription.subscription_query;
 
-            const auto resource_path = nmos::fields::resource_path(subscription.data);
-            resource_query match(subscription.version, resource_path, subscription.data.at(U("params")));
+            // cheapest check first, since most subscriptions are for a single resource type
+            if (!match.resource_path.empty() && match.resource_type != type) continue;
+
+            const auto& resource_path = match.resource_path;
 
             const bool pre_match = match(version, type, pre);
             const bool post_match = match(version, type, post);
@@ -168,20 +372,104 @@ namespace nmos
 
             // add the event for each websocket connection to this subscription
 
-            const value event = make_resource_event(resource_path, type, pre_match ? pre : value::null(), post_match ? post : value::null());
+            const auto event = std::make_shared<const value>(make_resource_event(resource_path, type, pre_match ? pre : value::null(), post_match ? post : value::null()));
 
-            for (const auto& id : subscription.sub_resources)
+            // i.e. each sub-resource of the subscription
+            for (const auto& websocket : get_sub_resources(resources, subscription))
             {
-                auto websocket = resources.find(id);
-                if (resources.end() == websocket) continue; // check connection is still open
+                websocket.pending_events->push_back(event);
+            }
+        }
+    }
 
-                resources.modify(websocket, [&resources, &event](nmos::resource& websocket)
-                {
-                    auto& events = websocket_resource_events(websocket);
-                    web::json::push_back(events, event);
-                    websocket.updated = strictly_increasing_update(resources);
-                });
+    void websocket_events::push_back(const event_ptr& event)
+    {
+        if (coalesce_size <= events.size() - sync_size)
+        {
+            coalesce();
+            // if there are still too many, they are for distinct resources, so none can be dropped without the client losing track
+            // of a resource, but the queue is still bounded by the number of resources
+            coalesce_size = (std::max)(max_size, 2 * (events.size() - sync_size));
+        }
+        events.push_back(event);
+        if (!changed)
+        {
+            changed = true;
+            if (nullptr != schedule) schedule->ready.push_back(id);
+        }
+    }
+
+    void websocket_events::coalesce()
+    {
+        // the sync events are kept as they are, since the client must be told about each resource as it was
+        // (the first and last change event for each resource path, in the order of the first)
+        std::map<utility::string_t, std::size_t> paths;
+        std::vector<std::pair<event_ptr, event_ptr>> changes;
+        for (auto change = events.begin() + sync_size; events.end() != change; ++change)
+        {
+            const auto inserted = paths.insert(std::make_pair((*change)->at(U("path")).as_string(), changes.size()));
+            if (inserted.second)
+            {
+                changes.push_back({ *change, *change });
+            }
+            else
+            {
+                changes[inserted.first->second].second = *change;
+            }
+        }
+
+        const auto size = events.size();
+        events.erase(events.begin() + sync_size, events.end());
+        for (const auto& change : changes)
+        {
+            const auto& first = *change.first;
+            const auto& last = *change.second;
+            if (change.first == change.second)
+            {
+                events.push_back(change.first);
+            }
+            else if (first.has_field(U("pre")) || last.has_field(U("post")))
+            {
+                // seems worthwhile to keep_order, as make_resource_event does
+                web::json::value coalesced_event = web::json::value::object(true);
+                coalesced_event[U("path")] = first.at(U("path"));
+                if (first.has_field(U("pre"))) coalesced_event[U("pre")] = first.at(U("pre"));
+                if (last.has_field(U("post"))) coalesced_event[U("post")] = last.at(U("post"));
+                events.push_back(std::make_shared<const web::json::value>(std::move(coalesced_event)));
             }
         }
+        coalesced += size - events.size();
+    }
+
+    void websocket_events::push_back_sync(const event_ptr& event)
+    {
+        events.insert(events.begin() + sync_size, event);
+        ++sync_size;
+        if (!changed)
+        {
+            changed = true;
+            if (nullptr != schedule) schedule->ready.push_back(id);
+        }
+    }
+
+    web::json::value websocket_events::make_message() const
+    {
+        web::json::value result = message;
+        auto& data = result[U("grain")][U("data")];
+        data = web::json::value::array(events.size());
+        size_t index = 0;
+        for (const auto& event : events)
+        {
+            data[index++] = *event;
+        }
+        return result;
+    }
+
+    void websocket_events::clear()
+    {
+        events.clear();
+        coalesce_size = max_size;
+        sync_size = 0;
+        coalesced = 0;
     }
 }
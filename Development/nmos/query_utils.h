@@ -1,9 +1,16 @@
 #ifndef NMOS_QUERY_UTILS_H
 #define NMOS_QUERY_UTILS_H
 
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <iterator>
+#include <map>
+#include <vector>
 #include "cpprest/basic_utils.h" // for utility::ostringstreamed, etc.
 #include "cpprest/json_utils.h" // for web::json::field_as_string_or, etc.
 #include "nmos/resources.h" // for nmos::resources
+#include "rql/rql.h"
 
 namespace nmos
 {
@@ -59,6 +66,94 @@ namespace nmos
         const paging_integer_field limit{ U("limit"), 30 };
     }
 
+    // Cursor-based paging is used by the Query API (since v1.1), by the created or updated timestamp, using the corresponding
+    // index, so that a page only costs a range scan rather than matching every resource
+    // see https://github.com/AMWA-TV/nmos-discovery-registration/blob/v1.2-dev/docs/2.5.%20APIs%20-%20Query%20Parameters.md#pagination
+    struct resource_paging
+    {
+        // flat_query_params may contain "paging.order", "paging.since", "paging.until" and "paging.limit"
+        // max_until should be the most recent update timestamp of the resources
+        resource_paging(const web::json::value& flat_query_params, const nmos::tai& max_until, size_t default_limit, size_t max_limit);
+
+        // check the query parameters were valid, e.g. the order is either "create" or "update"
+        bool valid() const { return valid_order && since <= until; }
+
+        // get the page of matching resources, most recent first, and update since and until to describe the page actually
+        // returned (since is exclusive, until is inclusive)
+        template <typename Predicate>
+        std::vector<const nmos::resource*> page(const nmos::resources& resources, Predicate match)
+        {
+            return order_by_created
+                ? page(resources.get<tags::created>(), &nmos::resource::created, match)
+                : page(resources.get<tags::updated>(), &nmos::resource::updated, match);
+        }
+
+        // get the page of matching resources from the specified candidates, e.g. found by a query plan, rather than all the resources
+        template <typename Predicate>
+        std::vector<const nmos::resource*> page(std::vector<const nmos::resource*> candidates, Predicate match)
+        {
+            const nmos::tai nmos::resource::* timestamp = order_by_created ? &nmos::resource::created : &nmos::resource::updated;
+            const auto less = [timestamp](const nmos::resource* lhs, const nmos::resource* rhs) { return lhs->*timestamp < rhs->*timestamp; };
+            const auto since_less = [timestamp](const nmos::tai& lhs, const nmos::resource* rhs) { return lhs < rhs->*timestamp; };
+            std::sort(candidates.begin(), candidates.end(), less);
+            return page(
+                std::upper_bound(candidates.cbegin(), candidates.cend(), since, since_less),
+                std::upper_bound(candidates.cbegin(), candidates.cend(), until, since_less),
+                timestamp, match);
+        }
+
+        bool order_by_created;
+        nmos::tai since;
+        nmos::tai until;
+        size_t limit;
+
+        // whether since was specified (and until was not) means the page starts from since, rather than ending at until
+        bool since_specified;
+        bool until_specified;
+        bool valid_order;
+
+    private:
+        template <typename Index, typename Predicate>
+        std::vector<const nmos::resource*> page(const Index& index, const nmos::tai nmos::resource::* timestamp, Predicate match)
+        {
+            return page(index.upper_bound(since), index.upper_bound(until), timestamp, match);
+        }
+
+        static const nmos::resource& deref(const nmos::resource& resource) { return resource; }
+        static const nmos::resource& deref(const nmos::resource* resource) { return *resource; }
+
+        template <typename Iterator, typename Predicate>
+        std::vector<const nmos::resource*> page(Iterator lower, Iterator upper, const nmos::tai nmos::resource::* timestamp, Predicate match)
+        {
+            std::vector<const nmos::resource*> result;
+            if (since_specified && !until_specified)
+            {
+                // scan forward from since
+                auto resource = lower;
+                for (; upper != resource && result.size() < limit; ++resource)
+                {
+                    if (match(deref(*resource))) result.push_back(&deref(*resource));
+                }
+                // if the page is full, it ends at the last matching resource
+                if (upper != resource && !result.empty()) until = result.back()->*timestamp;
+                std::reverse(result.begin(), result.end());
+            }
+            else
+            {
+                // scan backward from until
+                auto resource = upper;
+                while (lower != resource && result.size() < limit)
+                {
+                    --resource;
+                    if (match(deref(*resource))) result.push_back(&deref(*resource));
+                }
+                // if the page is full, it starts after the next older resource, whether or not that one matches
+                if (lower != resource) since = deref(*std::prev(resource)).*timestamp;
+            }
+            return result;
+        }
+    };
+
     // Helpers for advanced query options
 
     namespace experimental
@@ -75,18 +170,64 @@ namespace nmos
         // resource_path may be empty (matching all resource types) or e.g. "/nodes"
         resource_query(const nmos::api_version& version, const utility::string_t& resource_path, const web::json::value& flat_query_params);
 
-        result_type operator()(argument_type resource) const { return (*this)(resource.version, resource.type, resource.data); }
+        result_type operator()(argument_type resource) const { return (*this)(resource.version, resource.type, *resource.data); }
 
         result_type operator()(const nmos::api_version& resource_version, const nmos::type& resource_type, const web::json::value& resource_data) const;
 
         nmos::api_version version;
         utility::string_t resource_path;
+        // the type corresponding to a non-empty resource_path, to avoid string comparisons when matching
+        nmos::type resource_type;
         web::json::value basic_query;
         nmos::api_version downgrade_version;
         web::json::value rql_query;
         web::json::match_flag_type match_flags;
+        // basic_query compiled with match_flags, and rql_query compiled with the NMOS-specific comparison,
+        // once rather than for every resource
+        web::json::query_matcher basic_matcher;
+        rql::compiled_query rql_matcher;
+    };
+
+    // A query plan determines how to find the candidate resources for a query using the indices of the resources where possible,
+    // e.g. for "?id=...", "?device_id=..." or "?query.rql=eq(node_id,...)", so that only those candidates need to be matched
+    // against the whole query, rather than every resource
+    struct resource_query_plan
+    {
+        enum index_type
+        {
+            // every resource is a candidate
+            scan_all,
+            // every resource of the type is a candidate
+            scan_type,
+            // the resources with the ids are the candidates
+            find_id,
+            // the resources of the type with the super-resources with the ids are the candidates
+            find_super_resource
+        };
+
+        resource_query_plan() : index(scan_all), type(nmos::types::unknown), super_type(nmos::types::unknown) {}
+
+        index_type index;
+        nmos::type type;
+        nmos::type super_type;
+        // the ids, which are sorted and unique, and the field from which they were taken
+        std::vector<nmos::id> ids;
+        utility::string_t field;
+
+        // whether the plan only finds a (usually small) subset of the resources of the type
+        bool selective() const { return find_id == index || find_super_resource == index; }
+
+        // a short description, e.g. "scan", "type(sender)", "id" or "super_resource(device_id)"
+        utility::string_t description() const;
     };
 
+    // choose the plan for a query, from the basic query fields (only when matches must be exact) and the top-level terms
+    // of the RQL query, i.e. eq or in terms, including those of an and
+    resource_query_plan plan_resource_query(const resource_query& query);
+
+    // get the candidate resources according to the plan, which must then be matched against the whole query
+    std::vector<const nmos::resource*> get_candidate_resources(const nmos::resources& resources, const resource_query_plan& plan);
+
     // Helpers for constructing /subscriptions websocket grains
 
     // resource_path may be empty (matching all resource types) or e.g. "/nodes"
@@ -94,25 +235,92 @@ namespace nmos
 
     void insert_resource_events(nmos::resources& resources, const nmos::api_version& version, const nmos::type& type, const web::json::value& pre, const web::json::value& post);
 
-    inline web::json::value& websocket_message(nmos::resource& websocket)
+    // The schedule of websocket connections for the sending thread, so that each time it wakes up, it only needs to consider
+    // connections which have new events, or which were throttled and are now allowed to send, rather than every connection
+    // As for the resources themselves, the caller must hold the lock
+    struct websocket_events_schedule
     {
-        return websocket.data[U("message")];
-    }
+        websocket_events_schedule() : wake_count(0), message_count(0) {}
 
-    inline const web::json::value& websocket_message(const nmos::resource& websocket)
-    {
-        return websocket.data.at(U("message"));
-    }
+        // the connections which have had events appended since they were last considered
+        std::vector<nmos::id> ready;
 
-    inline web::json::value& websocket_resource_events(nmos::resource& websocket)
-    {
-        return websocket_message(websocket)[U("grain")][U("data")];
-    }
+        // the connections which have pending events but were throttled due to their subscription's max_update_rate_ms,
+        // ordered by when they are next allowed to send
+        std::multimap<tai_clock::time_point, nmos::id> throttled;
 
-    inline const web::json::value& websocket_resource_events(const nmos::resource& websocket)
+        // for monitoring, the number of times the sending thread has woken up, and the number of messages it has sent
+        // (reported periodically along with the number of pending events, see nmos::fields::query_ws_stats_interval)
+        std::uint64_t wake_count;
+        std::uint64_t message_count;
+    };
+
+    // The resource events pending on a websocket connection
+    // These are held outside the resources container (the websocket resource only has a pointer to them) so that appending
+    // an event doesn't require the container to be reindexed, or the websocket resource's update timestamp to be bumped
+    // Each event is shared between the connections to the same subscription, so connections with identical pending
+    // events can be identified cheaply, and sent the same message
+    // As for the resources themselves, the caller must hold the lock
+    struct websocket_events
     {
-        return websocket_message(websocket).at(U("grain")).at(U("data"));
-    }
+        typedef std::shared_ptr<const web::json::value> event_ptr;
+
+        // the schedule may be null, e.g. for testing
+        websocket_events(const nmos::id& id, const web::json::value& message, std::size_t max_size, websocket_events_schedule* schedule)
+            : id(id)
+            , message(message)
+            , max_size(max_size)
+            , coalesce_size(max_size)
+            , sync_size(0)
+            , coalesced(0)
+            , changed(false)
+            , throttled(false)
+            , schedule(schedule)
+        {}
+
+        // append an event, first coalescing the change events if the queue is already full
+        void push_back(const event_ptr& event);
+
+        // replace the change events for each resource path with one event, with the "pre" of the first and the "post" of the last,
+        // or with none at all if the resource was both added and removed, since the client then needn't be told about it
+        void coalesce();
+
+        // append an initial (unchanged, a.k.a. sync) event, which doesn't count towards the maximum size and is never
+        // coalesced, since otherwise the client would never be told about the resource
+        void push_back_sync(const event_ptr& event);
+
+        // make the message containing the pending events
+        web::json::value make_message() const;
+
+        // empty the queue, once the events have been sent
+        void clear();
+
+        // the websocket connection resource id
+        nmos::id id;
+
+        // the grain in which events are sent, see nmos::details::make_subscription_grain
+        web::json::value message;
+
+        // the pending events, oldest first, starting with any sync events
+        std::deque<event_ptr> events;
+        std::size_t max_size;
+        // the number of change events at which the queue is next coalesced; when coalescing doesn't get the queue below
+        // the maximum size, it's allowed to grow, rather than coalescing again every time an event is appended
+        std::size_t coalesce_size;
+        std::size_t sync_size;
+
+        // the number of events removed by coalescing because the queue was full, since the queue was last emptied
+        std::size_t coalesced;
+
+        // whether any events have been appended since this flag was last cleared by the consumer, i.e. whether the connection
+        // is in the schedule's ready list
+        bool changed;
+
+        // whether the connection is in the schedule's throttled map
+        bool throttled;
+
+        websocket_events_schedule* schedule;
+    };
 }
 
 #endif
@@ -1,5 +1,7 @@
 #include "nmos/query_ws_api.h"
 
+#include <algorithm>
+#include <map>
 #include "nmos/query_utils.h"
 #include "nmos/rational.h"
 #include "nmos/slog.h"
@@ -9,12 +11,12 @@ namespace nmos
 {
     inline resources::iterator find_subscription(resources& resources, const utility::string_t& ws_resource_path)
     {
-        auto resource = std::find_if(resources.begin(), resources.end(), [&ws_resource_path](const nmos::resources::value_type& resource)
+        auto subscriptions = get_resources_of_type(resources, nmos::types::subscription);
+        auto subscription = std::find_if(subscriptions.begin(), subscriptions.end(), [&ws_resource_path](const nmos::resources::value_type& subscription)
         {
-            return nmos::types::subscription == resource.type
-                && ws_resource_path == web::uri(nmos::fields::ws_href(resource.data)).path();
+            return ws_resource_path == web::uri(nmos::fields::ws_href(*subscription.data)).path();
         });
-        return resource;
+        return subscriptions.end() != subscription ? resources.project<0>(subscription) : resources.end();
     }
 
     web::websockets::experimental::listener::validate_handler make_query_ws_validate_handler(nmos::model& model, std::mutex& mutex, slog::base_gate& gate)
@@ -69,7 +71,7 @@ namespace nmos
         }
     }
 
-    web::websockets::experimental::listener::open_handler make_query_ws_open_handler(nmos::model& model, nmos::websockets& websockets, std::mutex& mutex, std::condition_variable& query_ws_events_condition, slog::base_gate& gate)
+    web::websockets::experimental::listener::open_handler make_query_ws_open_handler(nmos::model& model, nmos::websockets& websockets, nmos::websocket_events_schedule& schedule, std::mutex& mutex, std::condition_variable& query_ws_events_condition, slog::base_gate& gate)
     {
         using utility::string_t;
         using web::json::value;
@@ -77,7 +79,7 @@ namespace nmos
         // Source ID of the Query API instance issuing the data Grain
         const nmos::id source_id = nmos::make_id();
 
-        return [source_id, &model, &websockets, &mutex, &query_ws_events_condition, &gate](const utility::string_t& ws_resource_path, const web::websockets::experimental::listener::connection_id& connection_id)
+        return [source_id, &model, &websockets, &schedule, &mutex, &query_ws_events_condition, &gate](const utility::string_t& ws_resource_path, const web::websockets::experimental::listener::connection_id& connection_id)
         {
             std::lock_guard<std::mutex> lock(mutex);
 
@@ -92,45 +94,49 @@ namespace nmos
                 value data;
                 nmos::id id = nmos::make_id();
                 data[U("id")] = value::string(id);
-                data[U("subscription_id")] = value::string(subscription->id);
+                const nmos::id subscription_id = nmos::fields::id(*subscription->data);
+                data[U("subscription_id")] = value::string(subscription_id);
 
                 // create an initial websocket message with no data
 
-                const string_t resource_path = nmos::fields::resource_path(subscription->data);
+                const string_t resource_path = nmos::fields::resource_path(*subscription->data);
                 const string_t topic = resource_path + U('/');
-                data[U("message")] = details::make_subscription_grain(source_id, subscription->id, topic);
+                auto events = std::make_shared<websocket_events>(id, details::make_subscription_grain(source_id, subscription_id, topic), (std::size_t)nmos::fields::query_ws_max_events(model.settings), &schedule);
 
-                // populate it with the initial (unchanged, a.k.a. sync) data
+                // populate it with the initial (unchanged, a.k.a. sync) data, which is never coalesced
+
+                const auto& match = *subscription->subscription_query;
 
-                const resource_query match(subscription->version, resource_path, subscription->data.at(U("params")));
- 
-                std::vector<value> events;
                 for (const auto& resource : model.resources)
                 {
                     if (match(resource))
                     {
-                        events.push_back(make_resource_event(resource_path, resource.type, resource.data, resource.data));
+                        events->push_back_sync(std::make_shared<const value>(make_resource_event(resource_path, resource.type, *resource.data, *resource.data)));
                     }
                 }
+                if (!events->changed)
+                {
+                    // even with no sync data, the initial message is sent
+                    events->changed = true;
+                    schedule.ready.push_back(id);
+                }
 
-                data[U("message")][U("grain")][U("data")] = web::json::value_from_elements(events);
-
-                // track the websocket connection as a sub-resource of the subscription
+                // the websocket connection is tracked as a sub-resource of the subscription (by way of its subscription_id)
 
                 // never expire websocket connections, they are only deleted when the connection is closed
                 resource websocket{ subscription->version, nmos::types::websocket, data, true };
+                websocket.pending_events = events;
 
                 insert_resource(model.resources, std::move(websocket));
-                model.resources.modify(subscription, [&id](nmos::resource& subscription)
+                model.resources.modify(subscription, [](nmos::resource& subscription)
                 {
-                    subscription.sub_resources.insert(id);
                     // never expire a subscription while it has connections
                     subscription.health = health_forever;
                 });
 
                 websockets.insert({ id, connection_id });
 
-                slog::log<slog::severities::info>(gate, SLOG_FLF) << "Creating websocket connection: " << id << " to subscription: " << subscription->id;
+                slog::log<slog::severities::info>(gate, SLOG_FLF) << "Creating websocket connection: " << id << " to subscription: " << subscription_id;
 
                 slog::log<slog::severities::too_much_info>(gate, SLOG_FLF) << "Notifying query websockets thread";
                 query_ws_events_condition.notify_all();
@@ -157,19 +163,27 @@ namespace nmos
 
                 if (model.resources.end() != resource)
                 {
-                    slog::log<slog::severities::info>(gate, SLOG_FLF) << "Deleting websocket connection: " << resource->id;
+                    slog::log<slog::severities::info>(gate, SLOG_FLF) << "Deleting websocket connection: " << websocket->second;
+
+                    const nmos::id subscription_id = nmos::fields::subscription_id(*resource->data);
+
+                    erase_resource(model.resources, resource->id);
 
                     // a non-persistent subscription for which this was the last websocket connection should now expire unless a new connection is made soon
-                    modify_resource(model.resources, nmos::fields::subscription_id(resource->data), [&](nmos::resource& subscription)
+                    auto subscription = model.resources.find(subscription_id);
+                    if (model.resources.end() != subscription)
                     {
-                        subscription.sub_resources.erase(resource->id);
-                        if (subscription.sub_resources.empty())
+                        // like setting health_forever when the connection was made, this is bookkeeping, not a change to the subscription,
+                        // so it doesn't go through modify_resource, which would bump the update timestamp and generate resource events
+                        const bool last_connection = get_sub_resources(model.resources, *subscription).empty();
+                        if (last_connection)
                         {
-                            subscription.health = health_now();
+                            model.resources.modify(subscription, [](nmos::resource& subscription)
+                            {
+                                subscription.health = health_now();
+                            });
                         }
-                    });
-
-                    erase_resource(model.resources, resource->id);
+                    }
                 }
 
                 websockets.right.erase(websocket);
@@ -192,75 +206,147 @@ namespace nmos
         }
     }
 
-    void send_query_ws_events_thread(web::websockets::experimental::listener::websocket_listener& listener, nmos::model& model, nmos::websockets& websockets, std::mutex& mutex, std::condition_variable& condition, bool& shutdown, slog::base_gate& gate)
+    void send_query_ws_events_thread(web::websockets::experimental::listener::websocket_listener& listener, nmos::model& model, nmos::websockets& websockets, nmos::websocket_events_schedule& schedule, std::mutex& mutex, std::condition_variable& condition, bool& shutdown, slog::base_gate& gate)
     {
         using utility::string_t;
         using web::json::value;
 
         std::unique_lock<std::mutex> lock(mutex);
-        tai most_recent_message{};
-        auto earliest_necessary_update = (tai_clock::time_point::max)();
+
+        auto next_stats = tai_clock::now();
 
         for (;;)
         {
-            // wait for the thread to be interrupted either because there are resource changes, or because the server is being shut down
+            // wait for the thread to be interrupted either because there are resource events, or because the server is being shut down
             // or because message sending was throttled earlier
-            wait_until(condition, lock, earliest_necessary_update, [&]{ return shutdown || most_recent_message < most_recent_update(model.resources); });
+            const auto earliest_necessary_update = schedule.throttled.empty() ? (tai_clock::time_point::max)() : schedule.throttled.begin()->first;
+            wait_until(condition, lock, earliest_necessary_update, [&]{ return shutdown || !schedule.ready.empty(); });
             if (shutdown) break;
-            most_recent_message = most_recent_update(model.resources);
-
-            slog::log<slog::severities::too_much_info>(gate, SLOG_FLF) << "Got notification on query websockets thread";
+            const auto most_recent_message = strictly_increasing_update(model.resources);
 
             const auto now = tai_clock::now();
 
-            earliest_necessary_update = (tai_clock::time_point::max)();
+            // the connections which need to be considered are those which have new events, and those which are no longer throttled
+            std::vector<nmos::id> due;
+            due.swap(schedule.ready);
+            const auto no_longer_throttled = schedule.throttled.upper_bound(now);
+            for (auto throttled = schedule.throttled.begin(); no_longer_throttled != throttled; ++throttled)
+            {
+                const auto resource = find_resource(model.resources, { throttled->second, nmos::types::websocket });
+                if (model.resources.end() == resource) continue;
+                resource->pending_events->throttled = false;
+                due.push_back(throttled->second);
+            }
+            schedule.throttled.erase(schedule.throttled.begin(), no_longer_throttled);
+            // a throttled connection may also have had new events
+            std::sort(due.begin(), due.end());
+            due.erase(std::unique(due.begin(), due.end()), due.end());
+
+            ++schedule.wake_count;
+            slog::log<slog::severities::too_much_info>(gate, SLOG_FLF) << "Got notification on query websockets thread (wake-up: " << schedule.wake_count << ", due connections: " << due.size() << ", throttled connections: " << schedule.throttled.size() << ")";
+
+            // periodically report the counters, and the depth of the queues before anything is sent, for monitoring
+            const auto stats_interval = std::chrono::seconds(nmos::fields::query_ws_stats_interval(model.settings));
+            if (std::chrono::seconds::zero() != stats_interval && next_stats <= now)
+            {
+                std::size_t connection_count = 0;
+                std::size_t pending_count = 0;
+                std::size_t max_pending_count = 0;
+                for (const auto& websocket : get_resources_of_type(model.resources, nmos::types::websocket))
+                {
+                    const auto pending = websocket.pending_events->events.size();
+                    ++connection_count;
+                    pending_count += pending;
+                    max_pending_count = (std::max)(max_pending_count, pending);
+                }
+                slog::log<slog::severities::info>(gate, SLOG_FLF) << "Query websockets thread has woken up " << schedule.wake_count << " times and sent " << schedule.message_count << " messages; "
+                    << connection_count << " connections have " << pending_count << " pending events (at most " << max_pending_count << " on one connection), " << schedule.throttled.size() << " connections are throttled";
+                next_stats = now + stats_interval;
+            }
+
+            // connections to the same subscription with identical pending events share a message, which is only serialized once
+            // (a new connection's initial events are never identical to another's, but thereafter, connections usually keep in step)
+            struct shared_message
+            {
+                std::vector<std::shared_ptr<websocket_events>> events;
+                std::vector<web::websockets::experimental::listener::connection_id> connections;
+            };
+            std::map<nmos::id, std::vector<shared_message>> messages;
 
-            for (const auto& websocket : websockets.left)
+            for (const auto& id : due)
             {
-                // for each websocket connection that has valid websocket connection and subscription resources
-                const auto resource = find_resource(model.resources, { websocket.first, nmos::types::websocket });
+                // for each due websocket connection that is still open, and has valid websocket connection and subscription resources
+                const auto websocket = websockets.left.find(id);
+                if (websockets.left.end() == websocket) continue;
+                const auto resource = find_resource(model.resources, { id, nmos::types::websocket });
                 if (model.resources.end() == resource) continue;
-                const auto subscription = model.resources.find(nmos::fields::subscription_id(resource->data));
+                const auto subscription = model.resources.find(nmos::fields::subscription_id(*resource->data));
                 if (model.resources.end() == subscription) continue;
                 // and has events to send
-                auto& events = websocket_resource_events(*resource);
-                if (0 == events.size()) continue;
+                auto& events = *resource->pending_events;
+                events.changed = false;
+                if (events.events.empty()) continue;
 
                 // throttle messages according to the subscription's max_update_rate_ms
-                const auto max_update_rate = std::chrono::milliseconds(nmos::fields::max_update_rate_ms(subscription->data));
-                const auto earliest_allowed_update = time_point_from_tai(details::get_subscription_grain_timestamp(websocket_message(*resource))) + max_update_rate;
+                const auto max_update_rate = std::chrono::milliseconds(nmos::fields::max_update_rate_ms(*subscription->data));
+                const auto earliest_allowed_update = time_point_from_tai(details::get_subscription_grain_timestamp(events.message)) + max_update_rate;
                 if (earliest_allowed_update > now)
                 {
-                    // make sure to send a message as soon as allowed
-                    if (earliest_allowed_update < earliest_necessary_update)
+                    // make sure to send a message as soon as allowed, but just don't do it now!
+                    // (a connection which is already throttled is still in the schedule)
+                    if (!events.throttled)
                     {
-                        earliest_necessary_update = earliest_allowed_update;
+                        schedule.throttled.insert({ earliest_allowed_update, id });
+                        events.throttled = true;
                     }
-                    // just don't do it now!
                     continue;
                 }
 
-                // set the message timestamp
-                model.resources.modify(resource, [&most_recent_message](nmos::resource& websocket)
+                if (0 != events.coalesced)
+                {
+                    slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "Coalesced " << events.coalesced << " changes on websocket connection: " << id;
+                }
+
+                // since the events are shared, comparing the queues only compares pointers
+                auto& subscription_messages = messages[nmos::fields::id(*subscription->data)];
+                auto shared = std::find_if(subscription_messages.begin(), subscription_messages.end(), [&events](const shared_message& candidate)
                 {
-                    details::set_subscription_grain_timestamp(websocket_message(websocket), most_recent_message);
+                    return candidate.events.front()->events == events.events;
                 });
+                if (subscription_messages.end() == shared)
+                {
+                    shared = subscription_messages.insert(subscription_messages.end(), shared_message());
+                }
+                shared->events.push_back(resource->pending_events);
+                shared->connections.push_back(websocket->second);
+            }
 
-                slog::log<slog::severities::info>(gate, SLOG_FLF) << "Sending " << events.size() << " changes on websocket connection: " << resource->id;
+            for (const auto& subscription_messages : messages)
+            {
+                for (const auto& shared : subscription_messages.second)
+                {
+                    const auto& events = *shared.events.front();
 
-                auto serialized = utility::us2s(websocket_message(*resource).serialize());
-                web::websockets::experimental::listener::websocket_outgoing_message message;
-                message.set_utf8_message(serialized);
+                    slog::log<slog::severities::info>(gate, SLOG_FLF) << "Sending " << events.events.size() << " changes on " << shared.connections.size() << " websocket connection(s) to subscription: " << subscription_messages.first;
 
-                listener.send(websocket.second, message);
+                    // set the message timestamp
+                    auto grain = events.make_message();
+                    details::set_subscription_grain_timestamp(grain, most_recent_message);
 
-                // reset the message for next time
-                model.resources.modify(resource, [&model](nmos::resource& websocket)
-                {
-                    auto& events = websocket_resource_events(websocket);
-                    events = value::array();
-                    websocket.updated = strictly_increasing_update(model.resources);
-                });
+                    auto serialized = utility::us2s(grain.serialize());
+                    web::websockets::experimental::listener::websocket_outgoing_message message;
+                    message.set_utf8_message(serialized);
+
+                    listener.send(shared.connections, message);
+                    schedule.message_count += shared.connections.size();
+
+                    // reset the queues for next time
+                    for (const auto& queue : shared.events)
+                    {
+                        details::set_subscription_grain_timestamp(queue->message, most_recent_message);
+                        queue->clear();
+                    }
+                }
             }
         }
     }
@@ -5,6 +5,7 @@
 #include <boost/bimap.hpp>
 #include "cpprest/ws_listener.h" // for web::websockets::experimental::listener::connection_id, etc.
 #include "nmos/model.h"
+#include "nmos/query_utils.h" // for nmos::websocket_events_schedule
 
 namespace slog
 {
@@ -20,10 +21,10 @@ namespace nmos
     typedef boost::bimap<nmos::id, web::websockets::experimental::listener::connection_id> websockets;
 
     web::websockets::experimental::listener::validate_handler make_query_ws_validate_handler(nmos::model& model, std::mutex& mutex, slog::base_gate& gate);
-    web::websockets::experimental::listener::open_handler make_query_ws_open_handler(nmos::model& model, nmos::websockets& websockets, std::mutex& mutex, std::condition_variable& query_ws_events_condition, slog::base_gate& gate);
+    web::websockets::experimental::listener::open_handler make_query_ws_open_handler(nmos::model& model, nmos::websockets& websockets, nmos::websocket_events_schedule& schedule, std::mutex& mutex, std::condition_variable& query_ws_events_condition, slog::base_gate& gate);
     web::websockets::experimental::listener::close_handler make_query_ws_close_handler(nmos::model& model, nmos::websockets& websockets, std::mutex& mutex, slog::base_gate& gate);
 
-    void send_query_ws_events_thread(web::websockets::experimental::listener::websocket_listener& listener, nmos::model& model, nmos::websockets& websockets, std::mutex& mutex, std::condition_variable& condition, bool& shutdown, slog::base_gate& gate);
+    void send_query_ws_events_thread(web::websockets::experimental::listener::websocket_listener& listener, nmos::model& model, nmos::websockets& websockets, nmos::websocket_events_schedule& schedule, std::mutex& mutex, std::condition_variable& condition, bool& shutdown, slog::base_gate& gate);
 
     namespace details
     {
@@ -1,5 +1,6 @@
 #include "nmos/registration_api.h"
 
+#include <thread>
 #include "nmos/api_utils.h"
 #include "nmos/model.h"
 #include "nmos/slog.h"
@@ -20,9 +21,23 @@ namespace nmos
         while (!condition.wait_until(lock, time_point_from_health(next_potential_expiry(model.resources) + nmos::fields::registration_expiry_interval(model.settings)), [&]{ return shutdown; }))
         {
             auto before = model.resources.size();
-            
+
             // expire all nodes for which there hasn't been a heartbeat in the last expiry interval
-            erase_expired_resources(model.resources, health_now() - nmos::fields::registration_expiry_interval(model.settings));
+            // in batches, releasing the lock in between
+            const auto expiration_health = health_now() - nmos::fields::registration_expiry_interval(model.settings);
+            const auto budget = std::chrono::milliseconds(nmos::fields::registration_expiry_budget_ms(model.settings));
+            while (erase_expired_resources(model.resources, expiration_health, tai_clock::now() + budget))
+            {
+                slog::log<slog::severities::more_info>(gate, SLOG_FLF) << (before - model.resources.size()) << " resources have expired so far";
+
+                query_ws_events_condition.notify_all();
+
+                lock.unlock();
+                std::this_thread::yield();
+                lock.lock();
+
+                if (shutdown) break;
+            }
 
             auto after = model.resources.size();
 
@@ -97,7 +112,7 @@ namespace nmos
             // Extract request body
 
             value body = req.extract_json().get();
-            nmos::type type = { nmos::fields::type(body) };
+            const nmos::type type = nmos::type_from_name(nmos::fields::type(body));
             value data = nmos::fields::data(body);
             nmos::id id = nmos::fields::id(data);
 
@@ -113,7 +128,7 @@ namespace nmos
             valid = valid && (creating || resource->type == type);
             // it shouldn't change the super-resource either
             const auto super_id_type = nmos::get_super_resource(data, type);
-            valid = valid && (creating || nmos::get_super_resource(resource->data, resource->type) == super_id_type);
+            valid = valid && (creating || nmos::get_super_resource(*resource->data, resource->type) == super_id_type);
 
             resources::iterator super_resource = nmos::find_resource(model.resources, super_id_type);
             const bool valid_super_resource = model.resources.end() != super_resource;
@@ -189,7 +204,7 @@ namespace nmos
             }
             else // bad type
             {
-                slog::log<slog::severities::error>(gate, SLOG_FLF) << nmos::api_stash(req, parameters) << "Registration requested for unrecognised resource type: " << type.name;
+                slog::log<slog::severities::error>(gate, SLOG_FLF) << nmos::api_stash(req, parameters) << "Registration requested for unrecognised resource type: " << nmos::fields::type(body);
                 valid = false;
             }
 
@@ -200,37 +215,16 @@ namespace nmos
                 {
                     nmos::resource created_resource{ version, type, data, false };
 
-                    if (allow_invalid_resources)
-                    {
-                        // join this resource to any sub-resources which were inserted out-of-order
-                        const auto id_type = std::make_pair(id, type);
-                        for (const auto& sub_resource : model.resources)
-                        {
-                            if (id_type == get_super_resource(sub_resource.data, sub_resource.type))
-                            {
-                                created_resource.sub_resources.insert(sub_resource.id);
-                            }
-                        }
-                    }
-
-                    insert_resource(model.resources, std::move(created_resource));
-
                     // all types (other than nodes, and subscriptions) must* be a sub-resource of an existing resource (*assuming not out-of-order insertion by allow_invalid_resources)
-                    if (super_resource != model.resources.end())
-                    {
-                        // this isn't modifying the visible data of the super_resouce though, so no resource events need to be generated
-                        // hence model.resources.modify(...) rather than modify_resource(model.resources, ...)
-                        model.resources.modify(super_resource, [&id](nmos::resource& super_resource)
-                        {
-                            super_resource.sub_resources.insert(id);
-                        });
-                    }
+                    // the relationship is indexed by the super-resource id, so any sub-resources which were inserted out-of-order are
+                    // automatically joined to this resource, and there's nothing to do to the super-resource itself
+                    insert_resource(model.resources, std::move(created_resource));
                 }
                 else
                 {
                     modify_resource(model.resources, id, [&data](nmos::resource& resource)
                     {
-                        resource.data = data;
+                        resource.data = std::make_shared<const value>(data);
                     });
                 }
 
@@ -298,24 +292,12 @@ namespace nmos
                     if (methods::GET == req.method())
                     {
                         slog::log<slog::severities::more_info>(gate, SLOG_FLF) << nmos::api_stash(req, parameters) << "Returning resource: " << resourceId;
-                        set_reply(res, status_codes::OK, resource->data);
+                        set_reply(res, status_codes::OK, *resource->data);
                     }
                     else if (methods::DEL == req.method())
                     {
                         slog::log<slog::severities::info>(gate, SLOG_FLF) << nmos::api_stash(req, parameters) << "Deleting resource: " << resourceId;
 
-                        // remove this resource from its super-resource's sub-resources
-                        resources::iterator super_resource = nmos::find_resource(model.resources, nmos::get_super_resource(resource->data, resource->type));
-                        if (super_resource != model.resources.end())
-                        {
-                            // this isn't modifying the visible data of the super_resouce though, so no resource events need to be generated
-                            // hence model.resources.modify(...) rather than modify_resource(model.resources, ...)
-                            model.resources.modify(super_resource, [&resource](nmos::resource& super_resource)
-                            {
-                                super_resource.sub_resources.erase(resource->id);
-                            });
-                        }
-
                         // not sure if we're responsible for erasing sub-resources or whether the client is... play safe?
                         erase_resource(model.resources, resource->id);
 
@@ -1,7 +1,8 @@
 #ifndef NMOS_RESOURCE_H
 #define NMOS_RESOURCE_H
 
-#include <set>
+#include <memory>
+#include <utility>
 #include "nmos/api_version.h"
 #include "nmos/json_fields.h"
 #include "nmos/health.h"
@@ -11,8 +12,12 @@
 
 namespace nmos
 {
+    struct resource_query;
+    struct serialized_representations;
+    struct websocket_events;
+
     // Resources have an API version, resource type and representation as json data
-    // Everything else is (internal) registry information: their id, references to their sub-resources, creation and update timestamps,
+    // Everything else is (internal) registry information: their id, a reference to their super-resource, creation and update timestamps,
     // and health which is usually propagated from a node, because only nodes get heartbeats and keep all their sub-resources alive
 
     struct resource
@@ -24,8 +29,9 @@ namespace nmos
         resource(api_version version, type type, web::json::value data, bool never_expire)
             : version(version)
             , type(type)
-            , data(data)
-            , id(fields::id(data))
+            , data(std::make_shared<const web::json::value>(std::move(data)))
+            , id(fields::id(*this->data))
+            , super_resource(compact_id(), types::unknown)
             , created(tai_now())
             , updated(created)
             , health(never_expire ? health_forever : created.seconds)
@@ -39,13 +45,18 @@ namespace nmos
 
         // resource data is stored directly as json rather than e.g. being deserialized to a class hierarchy to allow quick
         // prototyping; json validation at the API boundary would ensure the data met the schema for the specified version 
-        web::json::value data;
+        // the json is immutable, and shared by copies of the resource, e.g. in snapshots, and by the "pre" and "post" of resource
+        // events, so modifying the data means replacing it with a new value, see nmos::modify_resource
+        std::shared_ptr<const web::json::value> data;
 
         // could use fields::id(data) but the id is such an important index...
-        id id;
+        // so it's held in compact form, see nmos/id.h (fields::id(data) is still the string form, for the APIs)
+        compact_id id;
 
-        // sub-resources are tracked in order to optimise resource expiry and deletion
-        std::set<nmos::id> sub_resources;
+        // the super-resource id and type, see nmos::get_super_resource, which is set on insertion
+        // it is indexed in order to optimise resource expiry and deletion, and the joining of sub-resources that were
+        // inserted out-of-order, without a separate set of sub-resources being maintained for each resource
+        std::pair<compact_id, nmos::type> super_resource;
 
         // see https://github.com/AMWA-TV/nmos-discovery-registration/blob/v1.2-dev/docs/2.5.%20APIs%20-%20Query%20Parameters.md#pagination
         tai created;
@@ -53,6 +64,19 @@ namespace nmos
 
         // see https://github.com/AMWA-TV/nmos-discovery-registration/blob/v1.2-dev/docs/4.1.%20Behaviour%20-%20Registration.md#heartbeating
         health health;
+
+        // for a subscription, its query, which is compiled once when the subscription is inserted, rather than for every
+        // resource event; see nmos::insert_resource_events
+        std::shared_ptr<const resource_query> subscription_query;
+
+        // for a websocket connection, the resource events waiting to be sent, which are deliberately not part of the
+        // indexed data, so that appending to them is cheap; see nmos::insert_resource_events
+        std::shared_ptr<websocket_events> pending_events;
+
+        // the serialized representations of the data at each API version, which are only constructed when first requested,
+        // and are shared with copies of the resource (e.g. in snapshots) until the data is modified, when they are replaced
+        // rather than cleared; see nmos::serialized_downgrade
+        std::shared_ptr<serialized_representations> serialized;
     };
 }
 
@@ -1,9 +1,40 @@
 #include "nmos/resources.h"
 
+#include <algorithm>
+#include <vector>
+#include "nmos/api_downgrade.h"
 #include "nmos/query_utils.h"
 
 namespace nmos
 {
+    static const std::pair<id, type> no_resource{ {}, types::unknown };
+
+    // get the super-resource id and type in the form in which it's indexed
+    static std::pair<compact_id, type> get_super_resource_key(const resource& resource)
+    {
+        const auto super_resource = get_super_resource(*resource.data, resource.type);
+        return no_resource != super_resource ? std::make_pair(compact_id(super_resource.first), super_resource.second) : std::make_pair(compact_id(), types::unknown);
+    }
+
+    // check whether the super-resource of the specified resource exists
+    static bool has_super_resource(const resources& resources, const resource& resource)
+    {
+        if (types::unknown == resource.super_resource.second) return false;
+        auto super_resource = resources.find(resource.super_resource.first);
+        return resources.end() != super_resource && resource.super_resource.second == super_resource->type;
+    }
+
+    // get the ids of the sub-resources of the specified resource
+    static std::vector<compact_id> get_sub_resource_ids(const resources& resources, const resource& resource)
+    {
+        std::vector<compact_id> result;
+        for (const auto& sub_resource : get_sub_resources(resources, resource))
+        {
+            result.push_back(sub_resource.id);
+        }
+        return result;
+    }
+
     // Resource creation/update/deletion operations
 
     // insert a resource
@@ -15,34 +46,69 @@ namespace nmos
         {
             resource.health = resource.created.seconds;
         }
+        // and identify its super-resource, which may not (yet) exist
+        resource.super_resource = get_super_resource_key(resource);
+        // a resource whose super-resource exists inherits its health, i.e. it only expires along with its super-resource,
+        // so that a heartbeat only has to update the node; until then, it has its own health
+        if (has_super_resource(resources, resource))
+        {
+            resource.health = nmos::health_forever;
+        }
+        // and compile a subscription's query
+        if (nmos::types::subscription == resource.type)
+        {
+            resource.subscription_query = std::make_shared<const resource_query>(resource.version, nmos::fields::resource_path(*resource.data), resource.data->at(U("params")));
+        }
+        // and start with an empty cache of its serialized representations
+        resource.serialized = std::make_shared<serialized_representations>();
         auto result = resources.insert(std::move(resource));
 
         if (result.second)
         {
             auto& resource = *result.first;
-            insert_resource_events(resources, resource.version, resource.type, web::json::value::null(), resource.data);
+
+            // any sub-resources which were inserted before this resource now inherit its health
+            for (const auto& sub_resource : get_sub_resource_ids(resources, resource))
+            {
+                resources.modify(resources.find(sub_resource), [](nmos::resource& orphan) { orphan.health = nmos::health_forever; });
+            }
+
+            insert_resource_events(resources, resource.version, resource.type, web::json::value::null(), *resource.data);
         }
 
         return result;
     }
 
     // modify a resource
-    bool modify_resource(resources& resources, const id& id, std::function<void(resource&)> modifier)
+    bool modify_resource(resources& resources, const compact_id& id, std::function<void(resource&)> modifier)
     {
         auto found = resources.find(id);
+        // the modifier replaces rather than modifies the data, so this doesn't copy the json
         auto pre = found->data;
+        const bool inherited_health = has_super_resource(resources, *found);
 
         // set the update timestamp before applying the modifier
         auto resource_updated = nmos::strictly_increasing_update(resources);
         auto result = resources.modify(found, [&resource_updated, &modifier](resource& resource) {
             resource.updated = resource_updated;
             modifier(resource);
+            resource.super_resource = get_super_resource_key(resource);
+            // the data may have been modified, so start a new cache of its serialized representations
+            // (any snapshots still have the cache that matches their copy of the data)
+            resource.serialized = std::make_shared<serialized_representations>();
         });
 
         if (result)
         {
+            // if the resource has moved to a super-resource which doesn't (yet) exist, it needs its own health again, or vice versa
+            const bool inherits_health = has_super_resource(resources, *found);
+            if (inherited_health != inherits_health)
+            {
+                resources.modify(found, [&inherits_health](nmos::resource& resource) { resource.health = inherits_health ? nmos::health_forever : nmos::health_now(); });
+            }
+
             auto& resource = *found;
-            insert_resource_events(resources, resource.version, resource.type, pre, resource.data);
+            insert_resource_events(resources, resource.version, resource.type, *pre, *resource.data);
         }
 
         return result;
@@ -50,7 +116,7 @@ namespace nmos
 
     // erase the resource with the specified id from the specified resources (if present)
     // and return the count of the number of resources erased (including sub-resources)
-    resources::size_type erase_resource(resources& resources, const id& id)
+    resources::size_type erase_resource(resources& resources, const compact_id& id)
     {
         // also erase all sub-resources of this resource, i.e.
         // for a node, all devices with matching node_id
@@ -61,7 +127,7 @@ namespace nmos
         auto resource = resources.find(id);
         if (resources.end() != resource)
         {
-            for (auto& sub_resource : resource->sub_resources)
+            for (auto& sub_resource : get_sub_resource_ids(resources, *resource))
             {
                 count += erase_resource(resources, sub_resource);
             }
@@ -72,7 +138,7 @@ namespace nmos
 
             resources.erase(resource);
 
-            insert_resource_events(resources, version, type, pre, web::json::value::null());
+            insert_resource_events(resources, version, type, *pre, web::json::value::null());
 
             ++count;
         }
@@ -80,45 +146,42 @@ namespace nmos
     }
 
     // erase all resources which expired at or before the specified time from the specified model
-    void erase_expired_resources(resources& resources, const health& expiration_health)
+    // or as many as possible before the specified deadline, and return whether any expired resources remain
+    bool erase_expired_resources(resources& resources, const health& expiration_health, const tai_clock::time_point& deadline)
     {
         typedef resources::index<tags::health>::type by_health;
         by_health& healths = resources.get<tags::health>();
-        by_health::const_iterator unexpired = healths.lower_bound(expiration_health);
 
-        for (auto resource = healths.begin(); unexpired != resource; ++resource)
+        // these are nodes (and subscriptions), which don't have a super-resource, and any resources whose super-resource
+        // doesn't exist; their sub-resources inherit their health, so have also expired
+        // the least healthy is erased each time, rather than collecting all the expired resources up front, since when there are
+        // many, this is called once per batch, and collecting them every time would make a mass expiry quadratic
+        const auto expired = [&healths, &expiration_health]
         {
-            const auto version = resource->version;
-            const auto type = resource->type;
-            const auto pre = resource->data;
+            return healths.end() != healths.begin() && healths.begin()->health < expiration_health;
+        };
 
-            insert_resource_events(resources, version, type, pre, web::json::value::null());
+        // the deadline is checked after each expired resource and its sub-resources are erased, so there's always progress
+        while (expired())
+        {
+            const compact_id id = healths.begin()->id;
+            erase_resource(resources, id);
+            if (tai_clock::now() >= deadline) return expired();
         }
-
-        // should remove each of these resources from their super-resource's sub-resources
-        // but this is unnecessary because health is propagated from nodes (and subscriptions)
-        // which don't have a super-resource
-        healths.erase(healths.begin(), unexpired);
+        return false;
     }
 
     // find the resource with the specified id in the specified resources (if present) and
-    // set the health of the resource and all of its sub-resources, to prevent them expiring
-    void set_resource_health(resources& resources, const id& id, health health)
+    // set its health, to prevent it, and its sub-resources, which inherit its health, expiring
+    void set_resource_health(resources& resources, const compact_id& id, health health)
     {
         auto resource = resources.find(id);
         if (resources.end() != resource)
         {
-            for (auto& sub_resource : resource->sub_resources)
-            {
-                set_resource_health(resources, sub_resource, health);
-            }
-
             resources.modify(resource, [&health](nmos::resource& resource){ resource.health = health; });
         }
     }
 
-    static const std::pair<id, type> no_resource{};
-
     // get the super-resource id and type
     std::pair<id, type> get_super_resource(const web::json::value& data, const type& type)
     {
@@ -174,4 +237,28 @@ namespace nmos
         auto resource = resources.find(id_type.first);
         return resources.end() != resource && id_type.second == resource->type ? resource : resources.end();
     }
+
+    // get a snapshot of the specified resources, reusing the latest snapshot if the resources haven't changed since it was taken
+    resources_snapshot get_resources_snapshot(resources_snapshot& latest, const resources& resources)
+    {
+        // websocket connections are only bookkeeping for the Query API websocket subscriptions, and aren't exposed via the APIs,
+        // so they are excluded when detecting changes, and a client connecting or disconnecting doesn't invalidate the snapshot
+        // (there are usually only a few, so skipping over them is cheap)
+        auto& by_updated = resources.get<tags::updated>();
+        const auto most_recent = std::find_if(by_updated.rbegin(), by_updated.rend(), [](const resource& resource)
+        {
+            return nmos::types::websocket != resource.type;
+        });
+        const auto most_recent_update = by_updated.rend() != most_recent ? most_recent->updated : tai{};
+        const auto size = resources.size() - resources.get<tags::type>().count(nmos::types::websocket);
+
+        if (!latest.resources || latest.most_recent_update != most_recent_update || latest.size != size)
+        {
+            latest.resources = std::make_shared<const nmos::resources>(resources);
+            latest.most_recent_update = most_recent_update;
+            latest.size = size;
+            ++latest.generation;
+        }
+        return latest;
+    }
 }
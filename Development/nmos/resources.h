@@ -2,10 +2,12 @@
 #define NMOS_RESOURCES_H
 
 #include <functional>
+#include <memory>
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/hashed_index.hpp>
 #include <boost/multi_index/member.hpp>
 #include <boost/multi_index/ordered_index.hpp>
+#include <boost/range/iterator_range.hpp>
 #include "nmos/resource.h"
 
 // This declares a container type suitable for managing a node's resources, or all the resources in a registry,
@@ -22,16 +24,18 @@ namespace nmos
         struct created;
         struct updated;
         struct health;
+        struct super_resource;
     }
 
     typedef boost::multi_index_container<
         resource,
         boost::multi_index::indexed_by<
-            boost::multi_index::hashed_unique<boost::multi_index::tag<tags::id>, boost::multi_index::member<resource, const id, &resource::id>>,
-            boost::multi_index::ordered_non_unique<boost::multi_index::tag<tags::type>, boost::multi_index::member<resource, const type, &resource::type>>,
+            boost::multi_index::hashed_unique<boost::multi_index::tag<tags::id>, boost::multi_index::member<resource, const compact_id, &resource::id>>,
+            boost::multi_index::hashed_non_unique<boost::multi_index::tag<tags::type>, boost::multi_index::member<resource, const type, &resource::type>>,
             boost::multi_index::ordered_unique<boost::multi_index::tag<tags::created>, boost::multi_index::member<resource, const tai, &resource::created>>,
             boost::multi_index::ordered_unique<boost::multi_index::tag<tags::updated>, boost::multi_index::member<resource, tai, &resource::updated>>,
-            boost::multi_index::ordered_non_unique<boost::multi_index::tag<tags::health>, boost::multi_index::member<resource, health, &resource::health>>
+            boost::multi_index::ordered_non_unique<boost::multi_index::tag<tags::health>, boost::multi_index::member<resource, health, &resource::health>>,
+            boost::multi_index::hashed_non_unique<boost::multi_index::tag<tags::super_resource>, boost::multi_index::member<resource, std::pair<compact_id, type>, &resource::super_resource>>
         >
     > resources;
 
@@ -53,18 +57,19 @@ namespace nmos
     std::pair<resources::iterator, bool> insert_resource(resources& resources, resource&& resource);
 
     // modify a resource
-    bool modify_resource(resources& resources, const id& id, std::function<void(resource&)> modifier);
+    bool modify_resource(resources& resources, const compact_id& id, std::function<void(resource&)> modifier);
 
     // erase the resource with the specified id from the specified resources (if present)
     // and return the count of the number of resources erased (including sub-resources)
-    resources::size_type erase_resource(resources& resources, const id& id);
+    resources::size_type erase_resource(resources& resources, const compact_id& id);
 
     // erase all resources which expired at or before the specified time from the specified resources
-    void erase_expired_resources(resources& resources, const health& expiration_health);
+    // or as many as possible before the specified deadline, and return whether any expired resources remain
+    bool erase_expired_resources(resources& resources, const health& expiration_health, const tai_clock::time_point& deadline = (tai_clock::time_point::max)());
 
     // find the resource with the specified id in the specified resources (if present) and
-    // set the health of the resource and all of its sub-resources, to prevent them expiring
-    void set_resource_health(resources& resources, const id& id, health health = health_now());
+    // set its health, to prevent it, and its sub-resources, which inherit its health, expiring
+    void set_resource_health(resources& resources, const compact_id& id, health health = health_now());
 
     // Other helper functions for resources
 
@@ -73,8 +78,42 @@ namespace nmos
 
     bool has_resource(const resources& resources, const std::pair<id, type>& id_type);
 
+    // get the sub-resources of the specified resource, i.e. those resources whose super-resource it is
+    inline boost::iterator_range<resources::index<tags::super_resource>::type::const_iterator> get_sub_resources(const resources& resources, const resource& resource)
+    {
+        return boost::make_iterator_range(resources.get<tags::super_resource>().equal_range(std::make_pair(resource.id, resource.type)));
+    }
+
+    // get the resources of the specified type, without visiting any others
+    inline boost::iterator_range<resources::index<tags::type>::type::const_iterator> get_resources_of_type(const resources& resources, const type& type)
+    {
+        return boost::make_iterator_range(resources.get<tags::type>().equal_range(type));
+    }
+
     // only need a non-const version so far...
     resources::iterator find_resource(resources& resources, const std::pair<id, type>& id_type);
+
+    // Snapshots of the resources, so that readers need only hold the lock briefly
+
+    // an immutable copy of the resources, with a generation number which is incremented each time a new snapshot is taken
+    // boost::multi_index_container doesn't allow structural sharing between copies, so snapshots are taken lazily, i.e.
+    // at most once per change, by the first reader that needs one, rather than by every writer
+    struct resources_snapshot
+    {
+        resources_snapshot() : generation(0), most_recent_update(), size(0) {}
+
+        std::uint64_t generation;
+        std::shared_ptr<const nmos::resources> resources;
+
+        // the state of the resources when the snapshot was taken, excluding the websocket connections, used to detect changes
+        // (every insert or modify strictly increases the most recent update timestamp, and every erase reduces the size)
+        tai most_recent_update;
+        nmos::resources::size_type size;
+    };
+
+    // get a snapshot of the specified resources, reusing the latest snapshot if the resources haven't changed since it was taken
+    // the caller must hold the lock on the resources, but may release it while still using the returned snapshot
+    resources_snapshot get_resources_snapshot(resources_snapshot& latest, const resources& resources);
 }
 
 #endif
@@ -23,8 +23,28 @@ namespace nmos
         const web::json::field_as_integer_or node_port{ U("node_port"), 3212 };
         const web::json::field_as_integer_or connection_port{ U("connection_port"), 3215 };
 
+        // the default and maximum number of results per page for the Query API (since v1.1)
+        const web::json::field_as_integer_or query_paging_default{ U("query_paging_default"), 10 };
+        const web::json::field_as_integer_or query_paging_limit{ U("query_paging_limit"), 100 };
+
         // "Registration APIs should use a garbage collection interval of 12 seconds by default (triggered just after two failed heartbeats at the default 5 second interval)."
         const web::json::field_as_integer_or registration_expiry_interval{ U("registration_expiry_interval"), 12 };
+
+        // the maximum time in milliseconds for which expiring resources holds the lock, before releasing it to let API requests
+        // proceed, so that a mass expiry (e.g. when a whole rack loses power) doesn't stall the APIs
+        const web::json::field_as_integer_or registration_expiry_budget_ms{ U("registration_expiry_budget_ms"), 20 };
+
+        // the maximum number of resource events queued on each Query API websocket connection; if a connection falls
+        // further behind than this, e.g. due to its subscription's max_update_rate_ms, the events for each resource are
+        // coalesced into one, and if they are still too many, the queue is allowed to grow, so that no change is lost
+        const web::json::field_as_integer_or query_ws_max_events{ U("query_ws_max_events"), 10000 };
+
+        // the number of threads servicing the Query API websocket connections, e.g. the handshakes and sends
+        const web::json::field_as_integer_or query_ws_threads{ U("query_ws_threads"), 1 };
+
+        // the interval in seconds at which the Query API websocket events are reported at info level, i.e. the number of times
+        // the sending thread has woken up, the number of messages sent, and the number of pending events (0 means never)
+        const web::json::field_as_integer_or query_ws_stats_interval{ U("query_ws_stats_interval"), 60 };
     }
 }
 
@@ -40,6 +60,13 @@ namespace nmos
             const web::json::field_as_integer_or logging_port{ U("logging_port"), 5106 };
             const web::json::field_as_integer_or admin_port{ U("admin_port"), 3208 };
             const web::json::field_as_integer_or mdns_port{ U("mdns_port"), 3214 };
+
+            // what to do when messages are logged faster than they can be written out, "block", "drop_oldest" or "drop_newest"
+            // see nmos::experimental::overflow_policy
+            const web::json::field_as_string_or logging_overflow_policy{ U("logging_overflow_policy"), U("block") };
+
+            // the maximum number of log events held for the Logging API
+            const web::json::field_as_integer_or logging_events_capacity{ U("logging_events_capacity"), 1234 };
         }
     }
 }
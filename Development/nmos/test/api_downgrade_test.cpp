@@ -0,0 +1,122 @@
+// The first "test" is of course whether the header compiles standalone
+#include "nmos/api_downgrade.h"
+
+#include <chrono>
+#include <vector>
+#include "cpprest/json_utils.h"
+#include "nmos/resources.h"
+#include "bst/test/test.h"
+
+namespace
+{
+    nmos::resource make_node(const nmos::id& id)
+    {
+        web::json::value data;
+        data[nmos::fields::id] = web::json::value::string(id);
+        data[U("version")] = web::json::value::string(U("0:0"));
+        data[U("label")] = web::json::value::string(U("node"));
+        data[U("href")] = web::json::value::string(U("http://localhost:3212/"));
+        data[U("hostname")] = web::json::value::string(U("localhost"));
+        data[U("caps")] = web::json::value::object();
+        data[U("services")] = web::json::value::array();
+        data[U("description")] = web::json::value::string(U("a v1.2 node"));
+        data[U("tags")] = web::json::value::object();
+        data[U("api")] = web::json::value::object();
+        data[U("clocks")] = web::json::value::array();
+        data[U("interfaces")] = web::json::value::array();
+        return{ nmos::is04_versions::v1_2, nmos::types::node, data, false };
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testSerializedDowngrade)
+{
+    const nmos::id id = nmos::make_id();
+
+    nmos::resources resources;
+    BST_REQUIRE(nmos::insert_resource(resources, make_node(id)).second);
+    const auto& node = *resources.find(id);
+
+    // the serialized representation matches the downgraded data, and is only constructed once per version
+    const auto v1_0 = nmos::serialized_downgrade(node, nmos::is04_versions::v1_0);
+    BST_REQUIRE(nmos::downgrade(node, nmos::is04_versions::v1_0).serialize() == *v1_0);
+    BST_REQUIRE(v1_0 == nmos::serialized_downgrade(node, nmos::is04_versions::v1_0));
+    BST_REQUIRE(utility::string_t::npos == v1_0->find(U("description")));
+
+    const auto v1_2 = nmos::serialized_downgrade(node, nmos::is04_versions::v1_2);
+    BST_REQUIRE(nmos::downgrade(node, nmos::is04_versions::v1_2).serialize() == *v1_2);
+    BST_REQUIRE(v1_0 != v1_2);
+
+    // a snapshot shares the cache, until the resource is modified
+    const nmos::resources snapshot(resources);
+    const auto& snapshot_node = *snapshot.find(id);
+    BST_REQUIRE(v1_0 == nmos::serialized_downgrade(snapshot_node, nmos::is04_versions::v1_0));
+
+    nmos::modify_resource(resources, id, [](nmos::resource& resource)
+    {
+        auto data = *resource.data;
+        data[U("label")] = web::json::value::string(U("modified"));
+        resource.data = std::make_shared<const web::json::value>(std::move(data));
+    });
+
+    const auto modified = nmos::serialized_downgrade(node, nmos::is04_versions::v1_0);
+    BST_REQUIRE(v1_0 != modified);
+    BST_REQUIRE(nmos::downgrade(node, nmos::is04_versions::v1_0).serialize() == *modified);
+    BST_REQUIRE(v1_0 == nmos::serialized_downgrade(snapshot_node, nmos::is04_versions::v1_0));
+
+    // an array of the serialized representations
+    utility::ostringstream_t os;
+    nmos::serialize_downgrade(os, { &node, &snapshot_node }, nmos::is04_versions::v1_0);
+    BST_REQUIRE(U("[") + *modified + U(",") + *v1_0 + U("]") == os.str());
+
+    utility::ostringstream_t empty;
+    nmos::serialize_downgrade(empty, {}, nmos::is04_versions::v1_0);
+    BST_REQUIRE(U("[]") == empty.str());
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_BENCHMARK_CASE(testSerializedDowngradeBenchmark)
+{
+    // compare repeatedly downgrading and serializing 5k v1.2 nodes at v1.0, with and without the cache
+    const size_t count = 5000;
+    const int repeats = 10;
+
+    nmos::resources resources;
+    std::vector<const nmos::resource*> nodes;
+    for (size_t i = 0; i < count; ++i)
+    {
+        const nmos::id id = nmos::make_id();
+        nmos::insert_resource(resources, make_node(id));
+        nodes.push_back(&*resources.find(id));
+    }
+
+    size_t uncached_size = 0;
+    const auto uncached_start = std::chrono::steady_clock::now();
+    for (int i = 0; i < repeats; ++i)
+    {
+        utility::ostringstream_t os;
+        web::json::serialize(os, nodes, [](const nmos::resource* resource) { return nmos::downgrade(*resource, nmos::is04_versions::v1_0); });
+        uncached_size += os.str().size();
+    }
+    const auto uncached_duration = std::chrono::steady_clock::now() - uncached_start;
+
+    // the first response populates the cache, after which each response is just a concatenation
+    size_t cached_size = 0;
+    auto first_duration = std::chrono::steady_clock::duration::zero();
+    const auto cached_start = std::chrono::steady_clock::now();
+    for (int i = 0; i < repeats; ++i)
+    {
+        utility::ostringstream_t os;
+        nmos::serialize_downgrade(os, nodes, nmos::is04_versions::v1_0);
+        cached_size += os.str().size();
+        if (0 == i) first_duration = std::chrono::steady_clock::now() - cached_start;
+    }
+    const auto cached_duration = std::chrono::steady_clock::now() - cached_start - first_duration;
+
+    BST_REQUIRE_EQUAL(uncached_size, cached_size);
+
+    BST_MESSAGE(count << " v1.2 nodes at v1.0, per response: "
+        << std::chrono::duration_cast<std::chrono::milliseconds>(uncached_duration).count() / repeats << "ms uncached, "
+        << std::chrono::duration_cast<std::chrono::milliseconds>(first_duration).count() << "ms populating the cache, "
+        << std::chrono::duration_cast<std::chrono::milliseconds>(cached_duration).count() / (repeats - 1) << "ms cached");
+}
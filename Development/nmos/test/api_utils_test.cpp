@@ -1,6 +1,7 @@
 // The first "test" is of course whether the header compiles standalone
 #include "nmos/api_utils.h"
 
+#include <vector>
 #include "bst/test/test.h"
 
 ////////////////////////////////////////////////////////////////////////////////////////////
@@ -97,3 +98,39 @@ BST_TEST_CASE(testMakeErrorResponseBody)
     }
     // successful status code perhaps ought to throw?
 }
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testResourceTypeFromType)
+{
+    const std::vector<nmos::type> types{ nmos::types::node, nmos::types::device, nmos::types::source, nmos::types::flow, nmos::types::sender, nmos::types::receiver, nmos::types::subscription };
+    for (const auto& type : types)
+    {
+        BST_REQUIRE(type == nmos::type_from_resourceType(nmos::resourceType_from_type(type)));
+        BST_REQUIRE(type == nmos::type_from_name(type.name()));
+    }
+    BST_REQUIRE(nmos::types::node == nmos::type_from_resourceType(U("self")));
+    BST_REQUIRE(nmos::resourceType_from_type(nmos::types::websocket).empty());
+    BST_REQUIRE(nmos::types::unknown == nmos::type_from_name(U("foo")));
+    BST_REQUIRE_THROW(nmos::resourceType_from_type(nmos::types::unknown), std::out_of_range);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testMakeResourcesEntityTag)
+{
+    web::http::http_request req;
+    req.set_request_uri(U("/x-nmos/query/v1.2/senders?label=foo"));
+    const nmos::tai most_recent_update{ 1234, 5678 };
+
+    const auto entity_tag = nmos::make_resources_entity_tag(req, most_recent_update, 42);
+    BST_REQUIRE_EQUAL(U('"'), entity_tag.front());
+    BST_REQUIRE_EQUAL(U('"'), entity_tag.back());
+    BST_REQUIRE(entity_tag == nmos::make_resources_entity_tag(req, most_recent_update, 42));
+
+    // any change to the state of the resources, or to the request URI, changes the entity-tag
+    BST_REQUIRE(entity_tag != nmos::make_resources_entity_tag(req, nmos::tai{ 1234, 5679 }, 42));
+    BST_REQUIRE(entity_tag != nmos::make_resources_entity_tag(req, most_recent_update, 41));
+
+    web::http::http_request other;
+    other.set_request_uri(U("/x-nmos/query/v1.2/senders?label=bar"));
+    BST_REQUIRE(entity_tag != nmos::make_resources_entity_tag(other, most_recent_update, 42));
+}
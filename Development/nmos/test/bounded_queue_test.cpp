@@ -0,0 +1,176 @@
+// The first "test" is of course whether the header compiles standalone
+#include "nmos/bounded_queue.h"
+
+#include <chrono>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "bst/test/test.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testBoundedQueueOverflowPolicy)
+{
+    using namespace nmos::experimental;
+
+    BST_REQUIRE_EQUAL(overflow_block, parse_overflow_policy(U("block")));
+    BST_REQUIRE_EQUAL(overflow_drop_oldest, parse_overflow_policy(U("drop_oldest")));
+    BST_REQUIRE_EQUAL(overflow_drop_newest, parse_overflow_policy(U("drop_newest")));
+    BST_REQUIRE_EQUAL(overflow_block, parse_overflow_policy(U("")));
+
+    // the capacity is rounded up to a power of two
+    BST_REQUIRE_EQUAL(4, bounded_queue<std::string>(3).capacity());
+
+    // drop the newest
+    {
+        bounded_queue<std::string> queue(4);
+        for (int i = 0; i < 6; ++i)
+        {
+            BST_REQUIRE_EQUAL(i < 4, queue.push(std::to_string(i), overflow_drop_newest));
+        }
+        BST_REQUIRE_EQUAL(2, queue.overflows());
+        BST_REQUIRE_EQUAL(2, queue.dropped());
+
+        std::string value;
+        for (int i = 0; i < 4; ++i)
+        {
+            BST_REQUIRE(queue.try_pop(value));
+            BST_REQUIRE_EQUAL(std::to_string(i), value);
+        }
+        BST_REQUIRE(!queue.try_pop(value));
+    }
+
+    // drop the oldest
+    {
+        bounded_queue<std::string> queue(4);
+        for (int i = 0; i < 6; ++i)
+        {
+            BST_REQUIRE(queue.push(std::to_string(i), overflow_drop_oldest));
+        }
+        BST_REQUIRE_EQUAL(2, queue.overflows());
+        BST_REQUIRE_EQUAL(2, queue.dropped());
+
+        std::string value;
+        for (int i = 2; i < 6; ++i)
+        {
+            BST_REQUIRE(queue.try_pop(value));
+            BST_REQUIRE_EQUAL(std::to_string(i), value);
+        }
+        BST_REQUIRE(!queue.try_pop(value));
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testBoundedQueueProducers)
+{
+    using namespace nmos::experimental;
+
+    // 4 producers blocking on a small queue, so that they overflow, but nothing is lost, and each producer's elements stay in order
+    const int producer_count = 4;
+    const int count = 100000;
+
+    bounded_queue<std::pair<int, int>> queue(64);
+    std::vector<std::thread> producers;
+    for (int producer = 0; producer < producer_count; ++producer)
+    {
+        producers.push_back(std::thread([&queue, producer, count]
+        {
+            for (int i = 0; i < count; ++i)
+            {
+                queue.push(std::make_pair(producer, i), overflow_block);
+            }
+        }));
+    }
+
+    std::vector<int> next(producer_count, 0);
+    int popped = 0;
+    std::pair<int, int> value;
+    while (popped < producer_count * count)
+    {
+        if (queue.try_pop(value))
+        {
+            BST_REQUIRE_EQUAL(next[value.first], value.second);
+            ++next[value.first];
+            ++popped;
+        }
+    }
+    for (auto& producer : producers)
+    {
+        producer.join();
+    }
+
+    BST_REQUIRE(!queue.try_pop(value));
+    BST_REQUIRE_EQUAL(0, queue.dropped());
+}
+
+namespace
+{
+    // push from the specified number of producers, while a single consumer pops, and return the duration
+    template <typename Push, typename Pop>
+    std::chrono::steady_clock::duration run_producers_consumer(int producer_count, int count, Push push, Pop pop)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> producers;
+        for (int producer = 0; producer < producer_count; ++producer)
+        {
+            producers.push_back(std::thread([count, push]
+            {
+                for (int i = 0; i < count; ++i)
+                {
+                    push(i);
+                }
+            }));
+        }
+        int popped = 0;
+        while (popped < producer_count * count)
+        {
+            if (pop()) ++popped;
+        }
+        for (auto& producer : producers)
+        {
+            producer.join();
+        }
+        return std::chrono::steady_clock::now() - start;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_BENCHMARK_CASE(testBoundedQueueBenchmark)
+{
+    using namespace nmos::experimental;
+
+    // compare 4 producers and a consumer using the bounded queue vs. a std::queue protected by a mutex
+    const int producer_count = 4;
+    const int count = 200000;
+
+    bounded_queue<int> queue(8192);
+    const auto lock_free_duration = run_producers_consumer(producer_count, count,
+        [&queue](int i) { queue.push(i, overflow_block); },
+        [&queue]() -> bool { int value; return queue.try_pop(value); });
+
+    std::mutex mutex;
+    std::queue<int> locked;
+    const auto locked_duration = run_producers_consumer(producer_count, count,
+        [&](int i) { std::lock_guard<std::mutex> lock(mutex); locked.push(i); },
+        [&]() -> bool { std::lock_guard<std::mutex> lock(mutex); if (locked.empty()) return false; locked.pop(); return true; });
+
+    // and the cost of overflow, when there's no consumer at all and the newest messages are dropped
+    bounded_queue<int> overflowing(8192);
+    const auto overflow_start = std::chrono::steady_clock::now();
+    for (int i = 0; i < count; ++i)
+    {
+        overflowing.push(i, overflow_drop_newest);
+    }
+    const auto overflow_duration = std::chrono::steady_clock::now() - overflow_start;
+    BST_REQUIRE_EQUAL(count - overflowing.capacity(), overflowing.dropped());
+
+    const auto total = producer_count * count;
+    BST_MESSAGE(producer_count << " producers and a consumer: "
+        << total / std::chrono::duration_cast<std::chrono::duration<double>>(lock_free_duration).count() << " messages/s lock-free, "
+        << total / std::chrono::duration_cast<std::chrono::duration<double>>(locked_duration).count() << " messages/s locked");
+    BST_MESSAGE("a producer and no consumer: "
+        << std::chrono::duration_cast<std::chrono::nanoseconds>(overflow_duration).count() / count << "ns per push, "
+        << overflowing.dropped() << " of " << count << " messages dropped");
+}
@@ -0,0 +1,176 @@
+// The first "test" is of course whether the header compiles standalone
+#include "nmos/id.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+#include <boost/functional/hash.hpp>
+#include <boost/uuid/random_generator.hpp>
+#include "bst/test/test.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testCompactId)
+{
+    const nmos::id id{ U("3b8be755-08ff-452b-b217-c9151eb21193") };
+    const nmos::compact_id compact(id);
+
+    BST_REQUIRE_EQUAL(16, sizeof(nmos::compact_id));
+    BST_REQUIRE_STRING_EQUAL(utility::us2s(id), boost::uuids::to_string(compact.uuid));
+    BST_REQUIRE_EQUAL(compact, nmos::compact_id(id));
+
+    // non-canonical ids are still distinct from each other, and from the canonical form
+    const nmos::compact_id upper(U("3B8BE755-08FF-452B-B217-C9151EB21193"));
+    const nmos::compact_id braced(U("{3b8be755-08ff-452b-b217-c9151eb21193}"));
+    BST_REQUIRE_NE(compact, upper);
+    BST_REQUIRE_NE(compact, braced);
+    BST_REQUIRE_NE(upper, braced);
+    BST_REQUIRE_EQUAL(upper, nmos::compact_id(U("3B8BE755-08FF-452B-B217-C9151EB21193")));
+    BST_REQUIRE_NE(nmos::compact_id(U("foo")), nmos::compact_id(U("bar")));
+
+    // the nil id
+    BST_REQUIRE_EQUAL(nmos::compact_id(), nmos::compact_id(U("00000000-0000-0000-0000-000000000000")));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_BENCHMARK_CASE(testCompactIdFindBenchmark)
+{
+    // compare find() in a hashed container of 100k ids, keyed on the string form vs. the compact form
+    const size_t count = 100000;
+
+    std::vector<nmos::id> ids;
+    ids.reserve(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        ids.push_back(nmos::make_id());
+    }
+
+    const std::unordered_set<nmos::id> string_ids(ids.begin(), ids.end());
+    const std::unordered_set<nmos::compact_id, boost::hash<nmos::compact_id>> compact_ids(ids.begin(), ids.end());
+    BST_REQUIRE_EQUAL(count, string_ids.size());
+    BST_REQUIRE_EQUAL(count, compact_ids.size());
+
+    std::vector<nmos::compact_id> keys(ids.begin(), ids.end());
+
+    size_t string_found = 0;
+    const auto string_start = std::chrono::steady_clock::now();
+    for (const auto& id : ids)
+    {
+        if (string_ids.end() != string_ids.find(id)) ++string_found;
+    }
+    const auto string_duration = std::chrono::steady_clock::now() - string_start;
+
+    size_t compact_found = 0;
+    const auto compact_start = std::chrono::steady_clock::now();
+    for (const auto& key : keys)
+    {
+        if (compact_ids.end() != compact_ids.find(key)) ++compact_found;
+    }
+    const auto compact_duration = std::chrono::steady_clock::now() - compact_start;
+
+    BST_REQUIRE_EQUAL(count, string_found);
+    BST_REQUIRE_EQUAL(count, compact_found);
+
+    // memory per id, not counting the container node; the string form also requires a heap allocation, since 36 characters
+    // exceeds the small string optimization buffer
+    const auto string_size = sizeof(nmos::id) + (ids.front().capacity() + 1) * sizeof(utility::char_t);
+    const auto compact_size = sizeof(nmos::compact_id);
+
+    BST_MESSAGE(count << " ids, string keys: " << string_size << " bytes per id, "
+        << std::chrono::duration_cast<std::chrono::nanoseconds>(string_duration).count() / count << "ns per find(); "
+        << "compact keys: " << compact_size << " bytes per id, "
+        << std::chrono::duration_cast<std::chrono::nanoseconds>(compact_duration).count() / count << "ns per find()");
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testMakeId)
+{
+    const size_t count = 100000;
+
+    auto ids = nmos::make_ids(count);
+    BST_REQUIRE_EQUAL(count, ids.size());
+    ids.push_back(nmos::make_id());
+
+    std::unordered_set<nmos::id> unique;
+    for (const auto& id : ids)
+    {
+        // canonical form, so the compact form is parsed rather than name-based
+        boost::uuids::uuid uuid;
+        BST_REQUIRE(nmos::details::parse_canonical_uuid(uuid, id));
+        BST_REQUIRE_STRING_EQUAL(utility::us2s(id), boost::uuids::to_string(uuid));
+
+        // version 4, variant RFC 4122
+        BST_REQUIRE_EQUAL(boost::uuids::uuid::version_random_number_based, uuid.version());
+        BST_REQUIRE_EQUAL(boost::uuids::uuid::variant_rfc_4122, uuid.variant());
+
+        unique.insert(id);
+    }
+    BST_REQUIRE_EQUAL(count + 1, unique.size());
+}
+
+namespace
+{
+    // make ids on the specified number of threads, and return the overall rate in ids per second
+    template <typename MakeId>
+    double make_ids_per_second(int thread_count, size_t count_per_thread, MakeId make_id)
+    {
+        std::atomic<size_t> total(0);
+        std::vector<std::thread> threads;
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < thread_count; ++i)
+        {
+            threads.push_back(std::thread([&total, count_per_thread, make_id]
+            {
+                size_t size = 0;
+                for (size_t j = 0; j < count_per_thread; ++j)
+                {
+                    size += make_id().size();
+                }
+                total += size;
+            }));
+        }
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+        const auto duration = std::chrono::duration_cast<std::chrono::duration<double>>(std::chrono::steady_clock::now() - start);
+        BST_REQUIRE_EQUAL(thread_count * count_per_thread * 36, total.load());
+        return thread_count * count_per_thread / duration.count();
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_BENCHMARK_CASE(testMakeIdBenchmark)
+{
+    // ids per second made on one and many threads, by make_id and by the previous implementation, which constructed
+    // (and seeded) a new boost::uuids::random_generator for every id, so is given far fewer to make
+    const size_t count = 100000;
+    const size_t previous_count = 2000;
+    const int thread_count = (std::max)(4, (int)std::thread::hardware_concurrency());
+
+    const auto previous_make_id = []
+    {
+        return utility::s2us(boost::uuids::to_string(boost::uuids::random_generator()()));
+    };
+    const auto make_id = []
+    {
+        return nmos::make_id();
+    };
+
+    const auto one = make_ids_per_second(1, count, make_id);
+    const auto many = make_ids_per_second(thread_count, count, make_id);
+    const auto previous_one = make_ids_per_second(1, previous_count, previous_make_id);
+    const auto previous_many = make_ids_per_second(thread_count, previous_count, previous_make_id);
+
+    // the batch API, on one thread
+    const auto batch_start = std::chrono::steady_clock::now();
+    const auto batch = nmos::make_ids(count);
+    const auto batch_duration = std::chrono::duration_cast<std::chrono::duration<double>>(std::chrono::steady_clock::now() - batch_start);
+    BST_REQUIRE_EQUAL(count, batch.size());
+
+    BST_MESSAGE("make_id: " << (std::uint64_t)one << " ids/s on 1 thread, " << (std::uint64_t)many << " ids/s on " << thread_count << " threads; "
+        << "make_ids: " << (std::uint64_t)(count / batch_duration.count()) << " ids/s on 1 thread; "
+        << "previously: " << (std::uint64_t)previous_one << " ids/s on 1 thread, " << (std::uint64_t)previous_many << " ids/s on " << thread_count << " threads");
+}
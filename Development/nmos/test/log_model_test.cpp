@@ -0,0 +1,344 @@
+// The first "test" is of course whether the header compiles standalone
+#include "nmos/log_model.h"
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include "bst/test/test.h"
+
+namespace
+{
+    slog::async_log_message make_message(const std::string& str, slog::severity level = slog::severities::info)
+    {
+        return{ "file.cpp", 42, "function", level, str };
+    }
+
+    slog::async_log_message make_request_message(const std::string& str, slog::severity level, const web::http::method& method, const utility::string_t& resource_type)
+    {
+        auto message = make_message(str, level);
+        web::http::experimental::listener::route_parameters parameters;
+        parameters[U("resourceType")] = resource_type;
+        message.stream()
+            << nmos::stash_http_method(method)
+            << nmos::stash_request_uri(web::uri(U("/x-nmos/query/v1.2/") + resource_type))
+            << nmos::stash_route_parameters(parameters);
+        return message;
+    }
+
+    // the number of events in an index
+    template <typename Index>
+    std::size_t indexed_count(const Index& index)
+    {
+        std::size_t result = 0;
+        for (const auto& key : index) result += key.second.size();
+        return result;
+    }
+
+    // find the matching events according to the plan
+    std::vector<std::uint64_t> find_planned(const nmos::experimental::log_events& events, const nmos::experimental::log_events_query& query)
+    {
+        const auto plan = nmos::experimental::plan_log_events_query(events, query);
+        std::vector<std::uint64_t> candidates = plan.candidates;
+        if (!plan.indexed)
+        {
+            candidates.clear();
+            for (auto sequence = events.begin_sequence(); events.end_sequence() != sequence; ++sequence) candidates.push_back(sequence);
+        }
+        std::vector<std::uint64_t> result;
+        for (auto sequence : candidates)
+        {
+            if (plan.exact || query(events.json(sequence))) result.push_back(sequence);
+        }
+        return result;
+    }
+
+    // find the matching events by matching every one
+    std::vector<std::uint64_t> find_scanned(const nmos::experimental::log_events& events, const nmos::experimental::log_events_query& query)
+    {
+        std::vector<std::uint64_t> result;
+        for (auto sequence = events.begin_sequence(); events.end_sequence() != sequence; ++sequence)
+        {
+            if (query(events.json(sequence))) result.push_back(sequence);
+        }
+        return result;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testLogEventsJson)
+{
+    nmos::experimental::log_events events;
+    BST_REQUIRE(events.empty());
+
+    auto message = make_message("hello, world", slog::severities::warning);
+    web::http::experimental::listener::route_parameters parameters;
+    parameters[U("resourceType")] = U("nodes");
+    message.stream()
+        << nmos::stash_http_method(web::http::methods::GET)
+        << nmos::stash_request_uri(web::uri(U("/x-nmos/query/v1.2/nodes")))
+        << nmos::stash_route_parameters(parameters);
+    events.push_back(message);
+    events.push_back(make_message("goodbye"));
+
+    BST_REQUIRE_EQUAL(2, events.size());
+
+    const auto sequence = events.begin_sequence();
+    const auto json = events.json(sequence);
+    BST_REQUIRE_EQUAL(U("hello, world"), json.at(U("message")).as_string());
+    BST_REQUIRE_EQUAL(slog::severities::warning, json.at(U("level")).as_integer());
+    BST_REQUIRE_EQUAL(U("file.cpp"), json.at(U("source_location")).at(U("file")).as_string());
+    BST_REQUIRE_EQUAL(42, json.at(U("source_location")).at(U("line")).as_integer());
+    BST_REQUIRE_EQUAL(U("function"), json.at(U("source_location")).at(U("function")).as_string());
+    BST_REQUIRE_EQUAL(U("GET"), json.at(U("http_method")).as_string());
+    BST_REQUIRE_EQUAL(U("/x-nmos/query/v1.2/nodes"), json.at(U("request_uri")).as_string());
+    BST_REQUIRE_EQUAL(U("nodes"), json.at(U("route_parameters")).at(U("resourceType")).as_string());
+
+    // events without the stashed request details don't have those fields
+    const auto other = events.json(sequence + 1);
+    BST_REQUIRE(!other.has_field(U("http_method")));
+    BST_REQUIRE(!other.has_field(U("request_uri")));
+    BST_REQUIRE(!other.has_field(U("route_parameters")));
+
+    // each event can be found by its id
+    const auto id = json.at(U("id")).as_string();
+    BST_REQUIRE_EQUAL(sequence, events.find(id));
+    BST_REQUIRE_EQUAL(sequence + 1, events.find(other.at(U("id")).as_string()));
+    BST_REQUIRE(id != other.at(U("id")).as_string());
+    BST_REQUIRE_EQUAL(events.end_sequence(), events.find(nmos::make_id()));
+
+    // ids are not reused after the events are cleared
+    events.clear();
+    BST_REQUIRE(events.empty());
+    BST_REQUIRE_EQUAL(events.end_sequence(), events.find(id));
+    events.push_back(make_message("again"));
+    BST_REQUIRE(id != events.event_id(events.begin_sequence()));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testLogEventsCapacity)
+{
+    // the oldest events are discarded when the maximum number of events is reached
+    {
+        nmos::experimental::log_events events(3);
+        for (int i = 0; i < 5; ++i) events.push_back(make_message(std::to_string(i)));
+        BST_REQUIRE_EQUAL(3, events.size());
+        BST_REQUIRE_EQUAL(2, events.begin_sequence());
+        BST_REQUIRE_EQUAL(U("2"), events.json(events.begin_sequence()).at(U("message")).as_string());
+        BST_REQUIRE_EQUAL(U("4"), events.json(events.end_sequence() - 1).at(U("message")).as_string());
+        BST_REQUIRE_EQUAL(events.end_sequence(), events.find(events.event_id(1)));
+    }
+
+    // ... or when there's no space left for their strings, i.e. 10 events of 10 bytes on average
+    {
+        nmos::experimental::log_events events(10, 10);
+        const std::string large(30, 'x');
+        for (int i = 0; i < 5; ++i) events.push_back(make_message(large));
+        BST_REQUIRE_EQUAL(2, events.size());
+        for (auto sequence = events.begin_sequence(); events.end_sequence() != sequence; ++sequence)
+        {
+            BST_REQUIRE_EQUAL(utility::s2us(large), events.json(sequence).at(U("message")).as_string());
+        }
+
+        // an event too big to fit at all is truncated
+        events.push_back(make_message(std::string(200, 'y')));
+        BST_REQUIRE_EQUAL(1, events.size());
+        const auto message = events.json(events.begin_sequence()).at(U("message")).as_string();
+        BST_REQUIRE(!message.empty());
+        BST_REQUIRE(100 > message.size());
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testLogEventsSetCapacity)
+{
+    nmos::experimental::log_events events(10);
+    for (int i = 0; i < 10; ++i) events.push_back(make_message(std::to_string(i)));
+    const auto last = events.json(events.end_sequence() - 1);
+
+    // the most recent events are kept, with the same ids
+    events.set_capacity(4);
+    BST_REQUIRE_EQUAL(4, events.capacity());
+    BST_REQUIRE_EQUAL(4, events.size());
+    BST_REQUIRE_EQUAL(6, events.begin_sequence());
+    BST_REQUIRE_EQUAL(10, events.end_sequence());
+    BST_REQUIRE_EQUAL(last.serialize(), events.json(events.find(last.at(U("id")).as_string())).serialize());
+
+    events.set_capacity(8);
+    BST_REQUIRE_EQUAL(4, events.size());
+    for (int i = 10; i < 15; ++i) events.push_back(make_message(std::to_string(i)));
+    BST_REQUIRE_EQUAL(8, events.size());
+    BST_REQUIRE_EQUAL(U("7"), events.json(events.begin_sequence()).at(U("message")).as_string());
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testLogEventsIndices)
+{
+    nmos::experimental::log_events events(4);
+    events.push_back(make_request_message("a", slog::severities::info, web::http::methods::GET, U("nodes")));
+    events.push_back(make_request_message("b", slog::severities::warning, web::http::methods::POST, U("resource")));
+    events.push_back(make_message("c", slog::severities::error));
+
+    // one entry for each distinct value, with the sequence numbers of the events in order
+    BST_REQUIRE_EQUAL(3, events.levels().size());
+    BST_REQUIRE_EQUAL(3, indexed_count(events.levels()));
+    BST_REQUIRE_EQUAL(2, events.http_methods().size());
+    BST_REQUIRE_EQUAL(1, events.http_methods().count("GET"));
+    BST_REQUIRE_EQUAL(events.begin_sequence(), events.http_methods().at("GET").front());
+    BST_REQUIRE_EQUAL(2, events.route_parameters().size());
+    BST_REQUIRE_EQUAL(1, events.route_parameters().count({ "resourceType", "nodes" }));
+
+    // evicted events are removed from the indices, along with values no longer used
+    events.push_back(make_message("d"));
+    events.push_back(make_message("e"));
+    BST_REQUIRE_EQUAL(3, events.levels().size());
+    BST_REQUIRE_EQUAL(4, indexed_count(events.levels()));
+    BST_REQUIRE_EQUAL(2, events.levels().at(slog::severities::info).size());
+    BST_REQUIRE_EQUAL(events.end_sequence() - 1, events.levels().at(slog::severities::info).back());
+    BST_REQUIRE_EQUAL(1, events.http_methods().size());
+    BST_REQUIRE_EQUAL(0, events.http_methods().count("GET"));
+    BST_REQUIRE_EQUAL(1, events.route_parameters().size());
+
+    // and the indices are rebuilt when the capacity is changed
+    events.set_capacity(2);
+    BST_REQUIRE_EQUAL(1, events.levels().size());
+    BST_REQUIRE_EQUAL(2, indexed_count(events.levels()));
+    BST_REQUIRE(events.http_methods().empty());
+    BST_REQUIRE(events.route_parameters().empty());
+    BST_REQUIRE_EQUAL(events.end_sequence() - 1, events.levels().at(slog::severities::info).back());
+
+    events.clear();
+    BST_REQUIRE(events.levels().empty());
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testLogEventsQueryPlan)
+{
+    nmos::experimental::log_events events;
+    const web::http::method methods[] = { web::http::methods::GET, web::http::methods::POST, web::http::methods::DEL };
+    const utility::string_t resource_types[] = { U("nodes"), U("senders"), U("receivers") };
+    for (int i = 0; i < 30; ++i)
+    {
+        const auto level = slog::severity(10 * (i % 5) - 20);
+        if (0 == i % 4) events.push_back(make_message(std::to_string(i), level));
+        else events.push_back(make_request_message(std::to_string(i), level, methods[i % 3], resource_types[i % 2 + i % 3 / 2]));
+        // distinct timestamps
+        if (0 == i % 3) std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+
+    // a timestamp from the middle of the events, which must be URI-encoded in an RQL query
+    const auto timestamp = events.json(events.begin_sequence() + 15).at(U("timestamp")).as_string();
+    const auto encoded_timestamp = web::uri::encode_data_string(timestamp);
+
+    struct test_query
+    {
+        web::json::value basic_query;
+        utility::string_t rql_query;
+        utility::string_t description;
+        bool exact;
+    };
+    const test_query queries[] =
+    {
+        { web::json::value::object(), U(""), U("scan"), true },
+        { web::json::value_of({ { U("message"), JU("1") } }), U(""), U("scan"), false },
+        { web::json::value_of({ { U("level"), JU("10") } }), U(""), U("index(level)"), true },
+        { web::json::value_of({ { U("http_method"), JU("p") } }), U(""), U("index(http_method)"), true },
+        { web::json::value_of({ { U("route_parameters"), web::json::value_of({ { U("resourceType"), JU("NODES") } }) } }), U(""), U("index(route_parameters.resourceType)"), true },
+        { web::json::value_of({ { U("http_method"), JU("GET") }, { U("message"), JU("2") } }), U(""), U("index(http_method)"), false },
+        { web::json::value::object(), U("ge(level,10)"), U("index(level)"), true },
+        { web::json::value::object(), U("in(level,(-20,0))"), U("index(level)"), true },
+        { web::json::value::object(), U("ne(http_method,GET)"), U("index(http_method)"), true },
+        { web::json::value::object(), U("eq(route_parameters.resourceType,senders)"), U("index(route_parameters.resourceType)"), true },
+        { web::json::value::object(), U("lt(timestamp,") + encoded_timestamp + U(")"), U("index(timestamp)"), true },
+        { web::json::value::object(), U("le(timestamp,") + encoded_timestamp + U(")"), U("index(timestamp)"), true },
+        { web::json::value::object(), U("gt(timestamp,") + encoded_timestamp + U(")"), U("index(timestamp)"), true },
+        { web::json::value::object(), U("ge(timestamp,") + encoded_timestamp.substr(0, 10) + U(")"), U("index(timestamp)"), true },
+        { web::json::value::object(), U("eq(timestamp,") + encoded_timestamp + U(")"), U("index(timestamp)"), true },
+        { web::json::value::object(), U("and(ge(level,0),eq(http_method,POST),gt(timestamp,") + encoded_timestamp + U("))"), U("index(level,http_method,timestamp)"), true },
+        { web::json::value_of({ { U("level"), JU("-10") } }), U("or(eq(http_method,GET),eq(http_method,DELETE))"), U("index(level)"), false },
+        { web::json::value::object(), U("eq(message,7)"), U("scan"), false }
+    };
+
+    for (const auto& test : queries)
+    {
+        const nmos::experimental::log_events_query query(test.basic_query, test.rql_query.empty() ? web::json::value::null() : rql::parse_query(test.rql_query));
+        const auto plan = nmos::experimental::plan_log_events_query(events, query);
+        BST_REQUIRE_EQUAL(test.description, plan.description());
+        BST_REQUIRE_EQUAL(test.exact, plan.exact);
+        BST_REQUIRE(find_scanned(events, query) == find_planned(events, query));
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_BENCHMARK_CASE(testLogEventsQueryPlanBenchmark)
+{
+    // compare finding the errors among 100k events, using the level index, with matching every event
+    const int count = 100000;
+    nmos::experimental::log_events events(count);
+    for (int i = 0; i < count; ++i)
+    {
+        events.push_back(make_request_message("Returning 42 matching log events", 0 == i % 1000 ? slog::severities::error : slog::severities::too_much_info, web::http::methods::GET, U("nodes")));
+    }
+
+    const nmos::experimental::log_events_query query(web::json::value::object(), rql::parse_query(U("ge(level,20)")));
+
+    // repeat the query, as when a client pages through the results interactively
+    const int repeats = 10;
+
+    std::vector<std::uint64_t> planned;
+    const auto planned_start = std::chrono::steady_clock::now();
+    for (int i = 0; i < repeats; ++i) planned = find_planned(events, query);
+    const auto planned_duration = std::chrono::steady_clock::now() - planned_start;
+
+    std::vector<std::uint64_t> scanned;
+    const auto scanned_start = std::chrono::steady_clock::now();
+    for (int i = 0; i < repeats; ++i) scanned = find_scanned(events, query);
+    const auto scanned_duration = std::chrono::steady_clock::now() - scanned_start;
+
+    BST_REQUIRE_EQUAL(count / 1000, planned.size());
+    BST_REQUIRE(scanned == planned);
+
+    BST_MESSAGE(planned.size() << " errors among " << count << " events, per query: "
+        << std::chrono::duration_cast<std::chrono::microseconds>(planned_duration).count() / repeats << "us planned, "
+        << std::chrono::duration_cast<std::chrono::microseconds>(scanned_duration).count() / repeats << "us scanned");
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_BENCHMARK_CASE(testLogEventsBenchmark)
+{
+    // compare logging 100k events into the default capacity, with constructing the json for each event as it is
+    // logged, which is what the model used to do
+    const int count = 100000;
+    const auto message = make_message("Returning 42 matching log events");
+
+    nmos::experimental::log_events events;
+
+    const auto compact_start = std::chrono::steady_clock::now();
+    for (int i = 0; i < count; ++i) events.push_back(message);
+    const auto compact_duration = std::chrono::steady_clock::now() - compact_start;
+
+    std::size_t json_size = 0;
+    const auto json_start = std::chrono::steady_clock::now();
+    for (int i = 0; i < count; ++i)
+    {
+        events.push_back(message);
+        json_size += events.json(events.end_sequence() - 1).size();
+    }
+    const auto json_duration = std::chrono::steady_clock::now() - json_start;
+
+    BST_REQUIRE_EQUAL(events.capacity(), events.size());
+    BST_REQUIRE(0 != json_size);
+
+    // the memory retained per event is its record, its strings, and a sequence number in the level index
+    const auto& record = events.at(events.end_sequence() - 1);
+    std::size_t compact_size = sizeof(nmos::experimental::log_event_record) + sizeof(std::uint64_t);
+    for (auto length : record.lengths) compact_size += length;
+
+    // the json value is bigger than its serialization, so that's just a lower bound on what the model used to retain per event
+    // (and the json is now constructed as well as the compact record, so the difference is the cost of constructing it)
+    BST_MESSAGE(count << " events, per event: "
+        << std::chrono::duration_cast<std::chrono::nanoseconds>(compact_duration).count() / count << "ns and "
+        << compact_size << " bytes compact, "
+        << std::chrono::duration_cast<std::chrono::nanoseconds>(json_duration - compact_duration).count() / count << "ns more and over "
+        << json_size / count << " bytes as json");
+}
@@ -1,6 +1,9 @@
 // The first "test" is of course whether the header compiles standalone
 #include "nmos/query_utils.h"
 
+#include <chrono>
+#include <vector>
+#include "nmos/version.h"
 #include "bst/test/test.h"
 
 ////////////////////////////////////////////////////////////////////////////////////////////
@@ -49,3 +52,414 @@ BST_TEST_CASE(testOffsetLimitPaged)
         BST_REQUIRE_EQUAL(5, paged.count);
     }
 }
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testResourceQueryResourcePath)
+{
+    web::json::value data;
+    data[U("id")] = web::json::value::string(U("3b8be755-08ff-452b-b217-c9151eb21193"));
+    const auto version = nmos::is04_versions::v1_2;
+
+    // an empty resource_path matches all resource types
+    {
+        const nmos::resource_query match(version, U(""), web::json::value::object());
+        BST_REQUIRE(match(version, nmos::types::node, data));
+        BST_REQUIRE(match(version, nmos::types::flow, data));
+    }
+    // otherwise, only the corresponding resource type
+    {
+        const nmos::resource_query match(version, U("/flows"), web::json::value::object());
+        BST_REQUIRE(nmos::types::flow == match.resource_type);
+        BST_REQUIRE(match(version, nmos::types::flow, data));
+        BST_REQUIRE(!match(version, nmos::types::node, data));
+    }
+    // and an invalid resource_path matches nothing
+    {
+        const nmos::resource_query self(version, U("/self"), web::json::value::object());
+        BST_REQUIRE(!self(version, nmos::types::node, data));
+        const nmos::resource_query foo(version, U("/foo"), web::json::value::object());
+        BST_REQUIRE(!foo(version, nmos::types::unknown, data));
+    }
+}
+
+namespace
+{
+    // make an event for the node with the specified id, from and to the specified versions, where zero means none,
+    // e.g. (1, 0, 1) for an added node, (1, 1, 2) for a modified one, and (1, 2, 0) for a removed one
+    nmos::websocket_events::event_ptr make_node_event(int id, int pre, int post)
+    {
+        const auto node = [id](int version) -> web::json::value
+        {
+            if (0 == version) return web::json::value::null();
+            web::json::value data;
+            data[U("id")] = web::json::value::string(utility::ostringstreamed(id));
+            data[U("version")] = web::json::value::number(version);
+            return data;
+        };
+        return std::make_shared<const web::json::value>(nmos::make_resource_event(U("/nodes"), nmos::types::node, node(pre), node(post)));
+    }
+
+    // check the event for the node with the specified id, from and to the specified versions, where zero means none
+    void check_node_event(const web::json::value& event, int id, int pre, int post)
+    {
+        BST_REQUIRE(utility::ostringstreamed(id) == event.at(U("path")).as_string());
+        BST_REQUIRE_EQUAL(0 != pre, event.has_field(U("pre")));
+        if (0 != pre) BST_REQUIRE_EQUAL(pre, event.at(U("pre")).at(U("version")).as_integer());
+        BST_REQUIRE_EQUAL(0 != post, event.has_field(U("post")));
+        if (0 != post) BST_REQUIRE_EQUAL(post, event.at(U("post")).at(U("version")).as_integer());
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testWebsocketEvents)
+{
+    web::json::value message;
+    message[U("grain")][U("data")] = web::json::value::array();
+    nmos::websocket_events_schedule schedule;
+    nmos::websocket_events events(U("3b8be755-08ff-452b-b217-c9151eb21193"), message, 3, &schedule);
+    BST_REQUIRE(!events.changed);
+
+    // node 1 is added and modified twice, filling the queue, so when node 2 is added, node 1's events are coalesced
+    events.push_back(make_node_event(1, 0, 1));
+    events.push_back(make_node_event(1, 1, 2));
+    events.push_back(make_node_event(1, 2, 3));
+    events.push_back(make_node_event(2, 0, 1));
+    BST_REQUIRE(events.changed);
+    // the connection is only added to the ready list once
+    BST_REQUIRE_EQUAL(1, schedule.ready.size());
+    BST_REQUIRE_EQUAL(2, events.events.size());
+    BST_REQUIRE_EQUAL(2, events.coalesced);
+
+    // the events for distinct resources can't be coalesced, so the queue is allowed to grow rather than losing any of them
+    events.push_back(make_node_event(3, 0, 1));
+    events.push_back(make_node_event(4, 0, 1));
+    BST_REQUIRE_EQUAL(4, events.events.size());
+    BST_REQUIRE_EQUAL(2, events.coalesced);
+
+    const auto grain = events.make_message();
+    const auto& data = grain.at(U("grain")).at(U("data"));
+    BST_REQUIRE_EQUAL(4, data.size());
+    check_node_event(data.at(0), 1, 0, 3);
+    check_node_event(data.at(1), 2, 0, 1);
+    check_node_event(data.at(2), 3, 0, 1);
+    check_node_event(data.at(3), 4, 0, 1);
+
+    // a node which is both added and removed needn't be mentioned at all
+    events.push_back(make_node_event(1, 3, 0));
+    events.coalesce();
+    BST_REQUIRE_EQUAL(3, events.events.size());
+    BST_REQUIRE_EQUAL(4, events.coalesced);
+    check_node_event(*events.events.front(), 2, 0, 1);
+
+    // a queue with the same shared events compares equal, which allows connections to share a message
+    nmos::websocket_events same(U("3b8be755-08ff-452b-b217-c9151eb21194"), message, 3, nullptr);
+    same.events = events.events;
+    BST_REQUIRE(same.events == events.events);
+    same.push_back(make_node_event(5, 0, 1));
+    BST_REQUIRE(same.events != events.events);
+
+    events.clear();
+    BST_REQUIRE(events.events.empty());
+    BST_REQUIRE_EQUAL(0, events.coalesced);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testWebsocketSyncEvents)
+{
+    web::json::value message;
+    message[U("grain")][U("data")] = web::json::value::array();
+    nmos::websocket_events_schedule schedule;
+    nmos::websocket_events events(U("3b8be755-08ff-452b-b217-c9151eb21193"), message, 3, &schedule);
+
+    // more sync events than the maximum size
+    for (int id = 1; id <= 5; ++id)
+    {
+        events.push_back_sync(make_node_event(id, 1, 1));
+    }
+    BST_REQUIRE(events.changed);
+    BST_REQUIRE_EQUAL(1, schedule.ready.size());
+    BST_REQUIRE_EQUAL(5, events.events.size());
+    BST_REQUIRE_EQUAL(0, events.coalesced);
+
+    // change events arriving before the first send are coalesced with each other, never with the sync events
+    events.push_back(make_node_event(1, 1, 2));
+    events.push_back(make_node_event(1, 2, 3));
+    events.push_back(make_node_event(1, 3, 4));
+    events.push_back(make_node_event(2, 1, 2));
+    BST_REQUIRE_EQUAL(7, events.events.size());
+    BST_REQUIRE_EQUAL(2, events.coalesced);
+
+    const auto grain = events.make_message();
+    const auto& data = grain.at(U("grain")).at(U("data"));
+    BST_REQUIRE_EQUAL(7, data.size());
+    for (int id = 1; id <= 5; ++id) check_node_event(data.at(id - 1), id, 1, 1);
+    check_node_event(data.at(5), 1, 1, 4);
+    check_node_event(data.at(6), 2, 1, 2);
+
+    // once sent, the sync events no longer have any special status
+    events.clear();
+    BST_REQUIRE_EQUAL(0, events.sync_size);
+    for (int id = 1; id <= 5; ++id)
+    {
+        events.push_back(make_node_event(id, 1, 2));
+    }
+    BST_REQUIRE_EQUAL(5, events.events.size());
+    BST_REQUIRE_EQUAL(0, events.coalesced);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testWebsocketSyncEventsWithoutChanges)
+{
+    // with no room for change events at all, they are coalesced, but still never lost
+    web::json::value message;
+    message[U("grain")][U("data")] = web::json::value::array();
+    nmos::websocket_events events(U("3b8be755-08ff-452b-b217-c9151eb21193"), message, 0, nullptr);
+    events.push_back_sync(make_node_event(1, 1, 1));
+    for (int version = 1; version < 10; ++version)
+    {
+        events.push_back(make_node_event(1, version, version + 1));
+    }
+    events.coalesce();
+    BST_REQUIRE_EQUAL(2, events.events.size());
+    BST_REQUIRE_EQUAL(8, events.coalesced);
+    check_node_event(*events.events.front(), 1, 1, 1);
+    check_node_event(*events.events.back(), 1, 1, 10);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testResourcePaging)
+{
+    nmos::resources resources;
+    std::vector<nmos::tai> created;
+    for (int i = 0; i < 25; ++i)
+    {
+        web::json::value data;
+        data[U("id")] = web::json::value::string(nmos::make_id());
+        auto resource = nmos::insert_resource(resources, { nmos::is04_versions::v1_2, nmos::types::flow, data, false }).first;
+        created.push_back(resource->created);
+    }
+    const auto match_all = [](const nmos::resource&) { return true; };
+
+    // by default, the most recent page
+    {
+        nmos::resource_paging paging(web::json::value::object(), nmos::most_recent_update(resources), 10, 100);
+        BST_REQUIRE(paging.valid());
+        const auto page = paging.page(resources, match_all);
+        BST_REQUIRE_EQUAL(10, page.size());
+        BST_REQUIRE_EQUAL(created[24], page.front()->created);
+        BST_REQUIRE_EQUAL(created[15], page.back()->created);
+        // the page starts after the next older resource
+        BST_REQUIRE_EQUAL(created[14], paging.since);
+        BST_REQUIRE_EQUAL(created[24], paging.until);
+    }
+    // the previous page, i.e. until the since value of the most recent page
+    {
+        web::json::value params;
+        params[U("paging.until")] = web::json::value::string(nmos::make_version(created[14]));
+        params[U("paging.limit")] = web::json::value::string(U("20"));
+        nmos::resource_paging paging(params, nmos::most_recent_update(resources), 10, 100);
+        const auto page = paging.page(resources, match_all);
+        BST_REQUIRE_EQUAL(15, page.size());
+        BST_REQUIRE_EQUAL(created[14], page.front()->created);
+        BST_REQUIRE_EQUAL(created[0], page.back()->created);
+        BST_REQUIRE_EQUAL(nmos::tai{}, paging.since);
+    }
+    // a page from since, which is exclusive
+    {
+        web::json::value params;
+        params[U("paging.since")] = web::json::value::string(nmos::make_version(created[4]));
+        params[U("paging.limit")] = web::json::value::string(U("5"));
+        nmos::resource_paging paging(params, nmos::most_recent_update(resources), 10, 100);
+        const auto page = paging.page(resources, match_all);
+        BST_REQUIRE_EQUAL(5, page.size());
+        BST_REQUIRE_EQUAL(created[9], page.front()->created);
+        BST_REQUIRE_EQUAL(created[5], page.back()->created);
+        BST_REQUIRE_EQUAL(created[4], paging.since);
+        BST_REQUIRE_EQUAL(created[9], paging.until);
+    }
+    // an invalid order
+    {
+        web::json::value params;
+        params[U("paging.order")] = web::json::value::string(U("random"));
+        nmos::resource_paging paging(params, nmos::most_recent_update(resources), 10, 100);
+        BST_REQUIRE(!paging.valid());
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_BENCHMARK_CASE(testBasicQueryBenchmark)
+{
+    // compare the per-resource cost of matching a basic query by interpreting it with web::json::match_query,
+    // and with the query compiled once by resource_query, i.e. its basic_matcher, as well as the whole resource_query
+    const size_t count = 20000;
+
+    nmos::resources resources;
+    for (size_t i = 0; i < count; ++i)
+    {
+        web::json::value data;
+        data[U("id")] = web::json::value::string(nmos::make_id());
+        data[U("label")] = web::json::value::string(U("Sender ") + utility::ostringstreamed(i));
+        data[U("transport")] = web::json::value::string(U("urn:x-nmos:transport:rtp.mcast"));
+        data[U("tags")] = web::json::value::object();
+        data[U("tags")][U("location")] = web::json::value_of({ web::json::value::string(U("Studio ") + utility::ostringstreamed(i % 10)) });
+        data[U("version")] = web::json::value::string(U("1234567890:") + utility::ostringstreamed(i));
+        data[U("enabled")] = web::json::value::boolean(0 == i % 2);
+        nmos::insert_resource(resources, { nmos::is04_versions::v1_2, nmos::types::sender, data, false });
+    }
+
+    // case-insensitive substring matches on several fields, including one with a non-string value
+    web::json::value params;
+    params[U("label")] = web::json::value::string(U("SENDER 1"));
+    params[U("transport")] = web::json::value::string(U("rtp"));
+    params[U("tags.location")] = web::json::value::string(U("studio 8"));
+    params[U("enabled")] = web::json::value::string(U("true"));
+    params[U("query.match_type")] = web::json::value::string(U("substr,icase"));
+
+    const nmos::resource_query match(nmos::is04_versions::v1_2, U("/senders"), params);
+
+    size_t interpreted_count = 0;
+    const auto interpreted_start = std::chrono::steady_clock::now();
+    for (const auto& resource : resources)
+    {
+        if (web::json::match_query(*resource.data, match.basic_query, match.match_flags)) ++interpreted_count;
+    }
+    const auto interpreted_duration = std::chrono::steady_clock::now() - interpreted_start;
+
+    size_t compiled_count = 0;
+    const auto compiled_start = std::chrono::steady_clock::now();
+    for (const auto& resource : resources)
+    {
+        if (match.basic_matcher(*resource.data)) ++compiled_count;
+    }
+    const auto compiled_duration = std::chrono::steady_clock::now() - compiled_start;
+
+    size_t query_count = 0;
+    const auto query_start = std::chrono::steady_clock::now();
+    for (const auto& resource : resources)
+    {
+        if (match(resource)) ++query_count;
+    }
+    const auto query_duration = std::chrono::steady_clock::now() - query_start;
+
+    // e.g. "Sender 18", "Sender 108", "Sender 1018", "Sender 10008", ...
+    BST_REQUIRE_NE(0, compiled_count);
+    BST_REQUIRE_EQUAL(interpreted_count, compiled_count);
+    BST_REQUIRE_EQUAL(compiled_count, query_count);
+
+    // per-resource match cost in nanoseconds
+    const auto interpreted_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(interpreted_duration).count() / count;
+    const auto compiled_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(compiled_duration).count() / count;
+    const auto query_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(query_duration).count() / count;
+
+    BST_MESSAGE("basic query of 4 fields, substr and icase, per-resource match: "
+        << interpreted_ns << "ns interpreted, "
+        << compiled_ns << "ns compiled, "
+        << query_ns << "ns for the whole resource_query");
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testResourceQueryPlan)
+{
+    // two devices, each with three senders
+    nmos::resources resources;
+    std::vector<nmos::id> device_ids, sender_ids;
+    for (int i = 0; i < 2; ++i)
+    {
+        web::json::value device;
+        device[U("id")] = web::json::value::string(nmos::make_id());
+        device[U("node_id")] = web::json::value::string(nmos::make_id());
+        device_ids.push_back(device.at(U("id")).as_string());
+        nmos::insert_resource(resources, { nmos::is04_versions::v1_2, nmos::types::device, device, false });
+        for (int j = 0; j < 3; ++j)
+        {
+            web::json::value sender;
+            sender[U("id")] = web::json::value::string(nmos::make_id());
+            sender[U("device_id")] = web::json::value::string(device_ids.back());
+            sender_ids.push_back(sender.at(U("id")).as_string());
+            nmos::insert_resource(resources, { nmos::is04_versions::v1_2, nmos::types::sender, sender, false });
+        }
+    }
+
+    const auto plan_query = [](const utility::string_t& resource_path, const web::json::value& flat_query_params)
+    {
+        return nmos::plan_resource_query(nmos::resource_query(nmos::is04_versions::v1_2, resource_path, flat_query_params));
+    };
+
+    // no basic or rql query terms which can use an index
+    {
+        const auto plan = plan_query(U("/senders"), web::json::value::object());
+        BST_REQUIRE_EQUAL(nmos::resource_query_plan::scan_type, plan.index);
+        BST_REQUIRE(U("type(sender)") == plan.description());
+        BST_REQUIRE_EQUAL(6, nmos::get_candidate_resources(resources, plan).size());
+    }
+    {
+        const auto plan = plan_query(U(""), web::json::value::object());
+        BST_REQUIRE_EQUAL(nmos::resource_query_plan::scan_all, plan.index);
+        BST_REQUIRE_EQUAL(8, nmos::get_candidate_resources(resources, plan).size());
+    }
+    // basic query by id
+    {
+        web::json::value params;
+        params[U("id")] = web::json::value::string(sender_ids[4]);
+        const auto plan = plan_query(U("/senders"), params);
+        BST_REQUIRE_EQUAL(nmos::resource_query_plan::find_id, plan.index);
+        BST_REQUIRE_EQUAL(1, nmos::get_candidate_resources(resources, plan).size());
+        // the type must match too
+        BST_REQUIRE_EQUAL(0, nmos::get_candidate_resources(resources, plan_query(U("/devices"), params)).size());
+    }
+    // basic query by super-resource id
+    {
+        web::json::value params;
+        params[U("device_id")] = web::json::value::string(device_ids[1]);
+        const auto plan = plan_query(U("/senders"), params);
+        BST_REQUIRE_EQUAL(nmos::resource_query_plan::find_super_resource, plan.index);
+        BST_REQUIRE(U("super_resource(device_id)") == plan.description());
+        BST_REQUIRE_EQUAL(3, nmos::get_candidate_resources(resources, plan).size());
+    }
+    // substring matches can't use an index
+    {
+        web::json::value params;
+        params[U("device_id")] = web::json::value::string(device_ids[1]);
+        params[U("query.match_type")] = web::json::value::string(U("substr"));
+        BST_REQUIRE_EQUAL(nmos::resource_query_plan::scan_type, plan_query(U("/senders"), params).index);
+    }
+    // rql query terms
+    {
+        web::json::value params;
+        params[U("query.rql")] = web::json::value::string(U("and(eq(label,foo),in(id,(") + sender_ids[0] + U(",") + sender_ids[5] + U(",") + sender_ids[0] + U(")))"));
+        const auto plan = plan_query(U("/senders"), params);
+        BST_REQUIRE_EQUAL(nmos::resource_query_plan::find_id, plan.index);
+        BST_REQUIRE_EQUAL(2, plan.ids.size());
+        BST_REQUIRE_EQUAL(2, nmos::get_candidate_resources(resources, plan).size());
+    }
+    {
+        web::json::value params;
+        params[U("query.rql")] = web::json::value::string(U("eq(device_id,") + device_ids[0] + U(")"));
+        const auto plan = plan_query(U("/senders"), params);
+        BST_REQUIRE_EQUAL(nmos::resource_query_plan::find_super_resource, plan.index);
+        BST_REQUIRE_EQUAL(3, nmos::get_candidate_resources(resources, plan).size());
+    }
+    // an or can't use an index
+    {
+        web::json::value params;
+        params[U("query.rql")] = web::json::value::string(U("or(eq(device_id,") + device_ids[0] + U("),eq(label,foo))"));
+        BST_REQUIRE_EQUAL(nmos::resource_query_plan::scan_type, plan_query(U("/senders"), params).index);
+    }
+
+    // paging the candidates gives the same result as paging all the resources
+    {
+        web::json::value params;
+        params[U("device_id")] = web::json::value::string(device_ids[0]);
+        params[U("paging.limit")] = web::json::value::string(U("2"));
+        const nmos::resource_query match(nmos::is04_versions::v1_2, U("/senders"), params);
+        const auto plan = nmos::plan_resource_query(match);
+
+        nmos::resource_paging paging(params, nmos::most_recent_update(resources), 10, 100);
+        const auto page = paging.page(resources, match);
+        nmos::resource_paging candidate_paging(params, nmos::most_recent_update(resources), 10, 100);
+        const auto candidate_page = candidate_paging.page(nmos::get_candidate_resources(resources, plan), match);
+        BST_REQUIRE_EQUAL(2, page.size());
+        BST_REQUIRE(page == candidate_page);
+        BST_REQUIRE_EQUAL(paging.until, candidate_paging.until);
+    }
+}
@@ -0,0 +1,322 @@
+// The first "test" is of course whether the header compiles standalone
+#include "nmos/resources.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <vector>
+#include <boost/range/distance.hpp>
+#include "nmos/version.h"
+#include "bst/test/test.h"
+
+namespace
+{
+    // count allocations, for the benchmarks
+    // (replacing the global allocation functions affects the whole test binary, but they're cheap)
+    std::atomic<std::size_t> allocation_count(0);
+}
+
+void* operator new(std::size_t size)
+{
+    ++allocation_count;
+    if (void* ptr = std::malloc(0 != size ? size : 1)) return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) throw()
+{
+    std::free(ptr);
+}
+
+namespace
+{
+    nmos::resource make_resource(const nmos::type& type, const nmos::id& id, const utility::string_t& super_field = {}, const nmos::id& super_id = {})
+    {
+        web::json::value data;
+        data[nmos::fields::id] = web::json::value::string(id);
+        if (!super_field.empty()) data[super_field] = web::json::value::string(super_id);
+        return{ nmos::is04_versions::v1_2, type, data, false };
+    }
+
+    // make a node with 50 sub-resources, i.e. a device, with 12 sources, each with a flow, 13 senders and 12 receivers
+    void make_node_resources(std::vector<nmos::resource>& resources)
+    {
+        const auto node_id = nmos::make_id();
+        resources.push_back(make_resource(nmos::types::node, node_id));
+        const auto device_id = nmos::make_id();
+        resources.push_back(make_resource(nmos::types::device, device_id, U("node_id"), node_id));
+        for (int i = 0; i < 12; ++i)
+        {
+            const auto source_id = nmos::make_id();
+            resources.push_back(make_resource(nmos::types::source, source_id, U("device_id"), device_id));
+            resources.push_back(make_resource(nmos::types::flow, nmos::make_id(), U("source_id"), source_id));
+        }
+        for (int i = 0; i < 13; ++i)
+        {
+            resources.push_back(make_resource(nmos::types::sender, nmos::make_id(), U("device_id"), device_id));
+        }
+        for (int i = 0; i < 12; ++i)
+        {
+            resources.push_back(make_resource(nmos::types::receiver, nmos::make_id(), U("device_id"), device_id));
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testSubResources)
+{
+    std::vector<nmos::resource> node_resources;
+    make_node_resources(node_resources);
+    BST_REQUIRE_EQUAL(51, node_resources.size());
+
+    const nmos::id node_id = nmos::fields::id(*node_resources.front().data);
+
+    // insert the sub-resources before the node itself, as if out-of-order
+    nmos::resources resources;
+    for (auto resource = node_resources.rbegin(); node_resources.rend() != resource; ++resource)
+    {
+        nmos::resource copy(*resource);
+        BST_REQUIRE(nmos::insert_resource(resources, std::move(copy)).second);
+    }
+
+    auto node = resources.find(node_id);
+    BST_REQUIRE(resources.end() != node);
+    BST_REQUIRE_EQUAL(1, boost::distance(nmos::get_sub_resources(resources, *node)));
+    const auto& device = *nmos::get_sub_resources(resources, *node).begin();
+    BST_REQUIRE(nmos::types::device == device.type);
+    BST_REQUIRE_EQUAL(37, boost::distance(nmos::get_sub_resources(resources, device)));
+
+    // all the sub-resources inherit the node's health, even though they were inserted first
+    BST_REQUIRE_EQUAL(50, std::count_if(resources.begin(), resources.end(), [](const nmos::resource& resource) { return nmos::health_forever == resource.health; }));
+
+    // so a heartbeat only updates the node
+    nmos::set_resource_health(resources, node_id, 42);
+    BST_REQUIRE_EQUAL(42, resources.find(node_id)->health);
+    BST_REQUIRE_EQUAL(50, std::count_if(resources.begin(), resources.end(), [](const nmos::resource& resource) { return nmos::health_forever == resource.health; }));
+
+    // and the sub-resources expire along with the node
+    BST_REQUIRE(!nmos::erase_expired_resources(resources, 42));
+    BST_REQUIRE_EQUAL(51, resources.size());
+    BST_REQUIRE(!nmos::erase_expired_resources(resources, 43));
+    BST_REQUIRE(resources.empty());
+
+    // erase cascades to all sub-resources
+    for (const auto& resource : node_resources)
+    {
+        nmos::resource copy(resource);
+        BST_REQUIRE(nmos::insert_resource(resources, std::move(copy)).second);
+    }
+    BST_REQUIRE_EQUAL(51, nmos::erase_resource(resources, node_id));
+    BST_REQUIRE(resources.empty());
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_BENCHMARK_CASE(testSubResourcesBenchmark)
+{
+    // register 2k nodes each with 50 sub-resources, in shuffled order
+    const size_t node_count = 2000;
+
+    std::vector<nmos::resource> registrations;
+    registrations.reserve(node_count * 51);
+    for (size_t i = 0; i < node_count; ++i)
+    {
+        make_node_resources(registrations);
+    }
+    std::shuffle(registrations.begin(), registrations.end(), std::default_random_engine{ 42 });
+
+    nmos::resources resources;
+    const auto start = std::chrono::steady_clock::now();
+    for (auto& registration : registrations)
+    {
+        nmos::resource resource(registration);
+        nmos::insert_resource(resources, std::move(resource));
+    }
+    const auto duration = std::chrono::steady_clock::now() - start;
+    BST_REQUIRE_EQUAL(node_count * 51, resources.size());
+
+    // every resource was joined to its super-resource, regardless of registration order,
+    // so erasing the nodes erases everything
+    std::vector<nmos::id> node_ids;
+    for (const auto& node : nmos::get_resources_of_type(resources, nmos::types::node))
+    {
+        node_ids.push_back(nmos::fields::id(*node.data));
+    }
+    BST_REQUIRE_EQUAL(node_count, node_ids.size());
+    for (const auto& node_id : node_ids)
+    {
+        BST_REQUIRE_EQUAL(51, nmos::erase_resource(resources, node_id));
+    }
+    BST_REQUIRE(resources.empty());
+
+    // with index lookups, registration should scale linearly; with the previous O(N) scan for out-of-order sub-resources
+    // for each registration, this took several minutes
+    BST_MESSAGE(node_count << " nodes with 50 sub-resources each, in shuffled order: "
+        << std::chrono::duration_cast<std::chrono::milliseconds>(duration).count() << "ms in total, "
+        << std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count() / registrations.size() << "ns per registration");
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testEraseExpiredResourcesDeadline)
+{
+    nmos::resources resources;
+    for (int i = 0; i < 3; ++i)
+    {
+        std::vector<nmos::resource> node_resources;
+        make_node_resources(node_resources);
+        for (auto& resource : node_resources)
+        {
+            BST_REQUIRE(nmos::insert_resource(resources, std::move(resource)).second);
+        }
+    }
+    BST_REQUIRE_EQUAL(3 * 51, resources.size());
+
+    // with a deadline that has already passed, one node (and its sub-resources) is erased per batch
+    const auto expiration_health = nmos::health_now() + 1;
+    const auto deadline = nmos::tai_clock::now();
+    BST_REQUIRE(nmos::erase_expired_resources(resources, expiration_health, deadline));
+    BST_REQUIRE_EQUAL(2 * 51, resources.size());
+    BST_REQUIRE(nmos::erase_expired_resources(resources, expiration_health, deadline));
+    BST_REQUIRE_EQUAL(51, resources.size());
+    BST_REQUIRE(!nmos::erase_expired_resources(resources, expiration_health, deadline));
+    BST_REQUIRE(resources.empty());
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testSharedResourceData)
+{
+    std::vector<nmos::resource> node_resources;
+    make_node_resources(node_resources);
+
+    nmos::resources resources;
+    for (auto& resource : node_resources)
+    {
+        BST_REQUIRE(nmos::insert_resource(resources, std::move(resource)).second);
+    }
+    const auto& device = *nmos::get_resources_of_type(resources, nmos::types::device).begin();
+    const auto device_id = device.id;
+
+    // a copy of the resources, e.g. a snapshot, shares the data rather than copying it
+    const nmos::resources snapshot(resources);
+    const auto pre = snapshot.find(device_id)->data;
+    BST_REQUIRE(device.data == pre);
+
+    // modifying a resource replaces its data, leaving the copy unchanged
+    nmos::modify_resource(resources, device_id, [](nmos::resource& resource)
+    {
+        auto data = *resource.data;
+        data[U("label")] = web::json::value::string(U("modified"));
+        resource.data = std::make_shared<const web::json::value>(std::move(data));
+    });
+    BST_REQUIRE(device.data != pre);
+    BST_REQUIRE(U("modified") == device.data->at(U("label")).as_string());
+    BST_REQUIRE(pre == snapshot.find(device_id)->data);
+    BST_REQUIRE(!pre->has_field(U("label")));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testResourcesSnapshot)
+{
+    nmos::resources resources;
+    nmos::resources_snapshot latest;
+    const auto node_id = nmos::make_id();
+    nmos::insert_resource(resources, make_resource(nmos::types::node, node_id));
+    const auto first = nmos::get_resources_snapshot(latest, resources);
+    BST_REQUIRE_EQUAL(1, first.generation);
+
+    // the snapshot is reused until there's a change
+    BST_REQUIRE(first.resources == nmos::get_resources_snapshot(latest, resources).resources);
+
+    // websocket connections are excluded, so connecting and disconnecting doesn't invalidate the snapshot
+    const auto websocket_id = nmos::make_id();
+    nmos::insert_resource(resources, make_resource(nmos::types::websocket, websocket_id));
+    BST_REQUIRE_EQUAL(1, nmos::get_resources_snapshot(latest, resources).generation);
+    nmos::erase_resource(resources, websocket_id);
+    BST_REQUIRE_EQUAL(1, nmos::get_resources_snapshot(latest, resources).generation);
+
+    // but every other insert, modify or erase does
+    const auto device_id = nmos::make_id();
+    nmos::insert_resource(resources, make_resource(nmos::types::device, device_id, U("node_id"), node_id));
+    BST_REQUIRE_EQUAL(2, nmos::get_resources_snapshot(latest, resources).generation);
+    nmos::modify_resource(resources, node_id, [](nmos::resource&) {});
+    BST_REQUIRE_EQUAL(3, nmos::get_resources_snapshot(latest, resources).generation);
+    nmos::erase_resource(resources, device_id);
+    const auto last = nmos::get_resources_snapshot(latest, resources);
+    BST_REQUIRE_EQUAL(4, last.generation);
+    BST_REQUIRE_EQUAL(1, last.size);
+
+    // and the earlier snapshot is unaffected
+    BST_REQUIRE_EQUAL(1, first.resources->size());
+    BST_REQUIRE(first.resources->end() != first.resources->find(node_id));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_BENCHMARK_CASE(testSharedResourceDataBenchmark)
+{
+    // take 100 snapshots of 200 nodes each with 50 sub-resources, each after a registration update,
+    // which used to deep copy the json data of every resource every time
+    const size_t node_count = 200;
+    const size_t update_count = 100;
+
+    nmos::resources resources;
+    std::vector<nmos::resource> registrations;
+    for (size_t i = 0; i < node_count; ++i)
+    {
+        make_node_resources(registrations);
+    }
+    const auto node_id = registrations.front().id;
+    for (auto& registration : registrations)
+    {
+        nmos::insert_resource(resources, std::move(registration));
+    }
+
+    const auto update = [](nmos::resource& resource)
+    {
+        auto data = *resource.data;
+        data[U("version")] = web::json::value::string(nmos::make_version(resource.updated));
+        resource.data = std::make_shared<const web::json::value>(std::move(data));
+    };
+
+    // the baseline, i.e. what each update used to cost, when the data was held by value, so modify_resource deep copied
+    // the pre-update data, and the snapshot deep copied the data of every resource
+    std::size_t baseline_allocations = 0;
+    const auto baseline_start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < update_count; ++i)
+    {
+        const auto allocations_before = allocation_count.load();
+        const web::json::value pre = *resources.find(node_id)->data;
+        nmos::modify_resource(resources, node_id, update);
+        const nmos::resources snapshot(resources);
+        std::vector<web::json::value> data;
+        data.reserve(snapshot.size());
+        for (auto& resource : snapshot)
+        {
+            data.push_back(*resource.data);
+        }
+        baseline_allocations += allocation_count.load() - allocations_before;
+    }
+    const auto baseline_duration = std::chrono::steady_clock::now() - baseline_start;
+
+    // now, only the modified resource's data is copied, and the snapshot is taken only when there has been a change,
+    // so this should be dominated by copying the container's nodes and indices
+    nmos::resources_snapshot latest;
+    std::size_t allocations = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < update_count; ++i)
+    {
+        const auto allocations_before = allocation_count.load();
+        nmos::modify_resource(resources, node_id, update);
+        nmos::get_resources_snapshot(latest, resources);
+        allocations += allocation_count.load() - allocations_before;
+    }
+    const auto duration = std::chrono::steady_clock::now() - start;
+    BST_REQUIRE_EQUAL(update_count, latest.generation);
+
+    BST_MESSAGE(resources.size() << " resources, per registration update and snapshot: "
+        << baseline_allocations / update_count << " allocations and "
+        << std::chrono::duration_cast<std::chrono::microseconds>(baseline_duration).count() / update_count << "us with deep copies of the data, "
+        << allocations / update_count << " allocations and "
+        << std::chrono::duration_cast<std::chrono::microseconds>(duration).count() / update_count << "us with shared data");
+}
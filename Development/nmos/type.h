@@ -1,43 +1,85 @@
 #ifndef NMOS_TYPE_H
 #define NMOS_TYPE_H
 
+#include <cstddef>
 #include "cpprest/details/basic_types.h"
 
 namespace nmos
 {
     // Resources have a type
 
+    // a type is represented by a small integer, which indexes the table of type names, so that comparison
+    // and hashing are trivial, and the types can be used to partition the resources container cheaply
     // totally_ordered rather than just equality_comparable only to allow use of type as a key
-    // in associative containers; an alternative would be adding a std::hash override so that
-    // unordered associative containers could be used instead?
+    // in associative containers
     struct type
     {
-        utility::string_t name;
+        int value;
 
-        friend bool operator==(const type& lhs, const type& rhs) { return lhs.name == rhs.name; }
-        friend bool operator< (const type& lhs, const type& rhs) { return lhs.name <  rhs.name; }
+        utility::string_t name() const;
+
+        friend bool operator==(const type& lhs, const type& rhs) { return lhs.value == rhs.value; }
+        friend bool operator< (const type& lhs, const type& rhs) { return lhs.value <  rhs.value; }
         friend bool operator> (const type& lhs, const type& rhs) { return rhs < lhs; }
         friend bool operator!=(const type& lhs, const type& rhs) { return !(lhs == rhs); }
         friend bool operator<=(const type& lhs, const type& rhs) { return !(rhs < lhs); }
         friend bool operator>=(const type& lhs, const type& rhs) { return !(lhs < rhs); }
     };
 
+    inline std::size_t hash_value(const type& type)
+    {
+        return static_cast<std::size_t>(type.value);
+    }
+
     namespace types
     {
-        const type node{ U("node") };
-        const type device{ U("device") };
-        const type source{ U("source") };
-        const type flow{ U("flow") };
-        const type sender{ U("sender") };
-        const type receiver{ U("receiver") };
+        const type node{ 0 };
+        const type device{ 1 };
+        const type source{ 2 };
+        const type flow{ 3 };
+        const type sender{ 4 };
+        const type receiver{ 5 };
 
         // a subscription isn't strictly a resource but has many of the same behaviours (it is
         // exposed from the Query API in the same way), and can largely be managed identically
-        const type subscription{ U("subscription") };
+        const type subscription{ 6 };
 
         // similarly, the information about a specific websocket connection to a subscription isn't
         // even exposed from the Query API but is easily managed as a sub-resource of a subscription
-        const type websocket{ U("websocket") };
+        const type websocket{ 7 };
+
+        // any other name, e.g. in an invalid registration request
+        const type unknown{ 8 };
+
+        const int count = 9;
+
+        // the names, indexed by value
+        const utility::char_t* const names[count] =
+        {
+            U("node"),
+            U("device"),
+            U("source"),
+            U("flow"),
+            U("sender"),
+            U("receiver"),
+            U("subscription"),
+            U("websocket"),
+            U("")
+        };
+    }
+
+    inline utility::string_t type::name() const
+    {
+        return 0 <= value && value < types::count ? types::names[value] : types::names[types::unknown.value];
+    }
+
+    inline type type_from_name(const utility::string_t& name)
+    {
+        for (int value = 0; value < types::unknown.value; ++value)
+        {
+            if (name == types::names[value]) return{ value };
+        }
+        return types::unknown;
     }
 }
 
@@ -2,6 +2,7 @@
 
 #include <stack>
 #include <stdexcept>
+#include <vector>
 #include "cpprest/base_uri.h" // for uri::decode
 #include "cpprest/basic_utils.h"
 #include "cpprest/json_utils.h"
@@ -732,4 +733,420 @@ namespace rql
     {
         return details::default_any_operators(equal_to, less);
     }
+
+    // Helpers for compiled RQL queries
+
+    namespace details
+    {
+        enum compiled_operator
+        {
+            op_literal,
+            op_property,
+            op_and,
+            op_or,
+            op_not,
+            op_eq,
+            op_ne,
+            op_gt,
+            op_ge,
+            op_lt,
+            op_le,
+            op_in,
+            op_out,
+            op_contains,
+            op_excludes,
+            op_null,
+            op_matches,
+            op_count,
+            op_get,
+            op_value
+        };
+
+        struct operator_name
+        {
+            const utility::char_t* name;
+            compiled_operator op;
+        };
+
+        const operator_name operator_names[] =
+        {
+            { U("and"), op_and },
+            { U("or"), op_or },
+            { U("not"), op_not },
+            { U("eq"), op_eq },
+            { U("ne"), op_ne },
+            { U("gt"), op_gt },
+            { U("ge"), op_ge },
+            { U("lt"), op_lt },
+            { U("le"), op_le },
+            { U("in"), op_in },
+            { U("out"), op_out },
+            { U("contains"), op_contains },
+            { U("excludes"), op_excludes },
+            { U("null"), op_null },
+            { U("matches"), op_matches },
+            { U("count"), op_count },
+            { U("get"), op_get },
+            { U("value"), op_value }
+        };
+
+        struct compiled_node
+        {
+            compiled_node() : op(op_literal), any(false) {}
+
+            compiled_operator op;
+            // for relational operators and matches, whether to use the array-friendly variant
+            bool any;
+
+            // for a literal value
+            web::json::value value;
+            // for a property
+            std::vector<utility::string_t> key_path;
+            // for a call-operator
+            std::vector<compiled_node> args;
+            // for matches, when the pattern and options are literal values
+            std::shared_ptr<const utility::regex_t> regex;
+        };
+
+        compiled_operator find_operator(const utility::string_t& name)
+        {
+            for (const auto& operator_name : operator_names)
+            {
+                if (name == operator_name.name) return operator_name.op;
+            }
+            throw std::out_of_range("rql compile error - unsupported call-operator");
+        }
+
+        inline bool matches_icase(const web::json::value& args)
+        {
+            return args.size() > 2 ? args.at(2).as_string() == U("i") : false;
+        }
+
+        // see evaluator::operator()
+        compiled_node compile(const web::json::value& arg, bool extract_value, bool any_operators)
+        {
+            compiled_node result;
+
+            // arg is a call-operator
+            if (is_call_operator(arg))
+            {
+                result.op = find_operator(arg.at(U("name")).as_string());
+                const auto& args = arg.at(U("args"));
+                // throws json_exception if not an array
+                args.as_array();
+
+                switch (result.op)
+                {
+                case op_and:
+                case op_or:
+                    for (const auto& element : args.as_array())
+                    {
+                        result.args.push_back(compile(element, false, any_operators));
+                    }
+                    break;
+                case op_not:
+                case op_get:
+                case op_value:
+                    result.args.push_back(compile(args.at(0), false, any_operators));
+                    break;
+                case op_null:
+                case op_count:
+                    result.args.push_back(compile(args.at(0), true, any_operators));
+                    break;
+                case op_matches:
+                    result.any = any_operators;
+                    result.args.push_back(compile(args.at(0), true, any_operators));
+                    result.args.push_back(compile(args.at(1), false, any_operators));
+                    if (op_literal == result.args[1].op)
+                    {
+                        // throws web::json::json_exception if pattern or options are not strings
+                        // throws std::regex_error if the pattern is not valid
+                        result.regex = std::make_shared<utility::regex_t>(result.args[1].value.as_string(), matches_icase(args) ? utility::regex_t::icase : utility::regex_t::flag_type{});
+                    }
+                    else
+                    {
+                        // keep the options for evaluation
+                        result.value = web::json::value::boolean(matches_icase(args));
+                    }
+                    break;
+                default:
+                    // relational operators and set relation functions
+                    result.any = any_operators;
+                    result.args.push_back(compile(args.at(0), true, any_operators));
+                    result.args.push_back(compile(args.at(1), false, any_operators));
+                    break;
+                }
+            }
+            // arg is a value used as property key
+            else if (extract_value)
+            {
+                result.op = op_property;
+                result.key_path = web::json::split_key_path(arg.as_string());
+            }
+            // arg is a value
+            else
+            {
+                result.op = op_literal;
+                result.value = arg;
+            }
+
+            return result;
+        }
+
+        struct compiled_context
+        {
+            const web::json::object& object;
+            const comparator& equal_to;
+            const comparator& less;
+        };
+
+        web::json::value evaluate(const compiled_node& node, const compiled_context& context);
+
+        // avoid copying literal values which are only needed by reference
+        inline const web::json::value& evaluate(const compiled_node& node, const compiled_context& context, web::json::value& storage)
+        {
+            if (op_literal == node.op) return node.value;
+            storage = evaluate(node, context);
+            return storage;
+        }
+
+        // the relation between the property value (or one of its elements) and the provided value, see functions::eq, etc.
+        inline web::json::value relation(compiled_operator op, const web::json::value& property, const web::json::value& value, const compiled_context& context)
+        {
+            switch (op)
+            {
+            case op_eq: return context.equal_to(property, value);
+            case op_ne: return logical_operators::not(context.equal_to(property, value));
+            case op_gt: return context.less(value, property);
+            case op_ge: return logical_operators::not(context.less(property, value));
+            case op_lt: return context.less(property, value);
+            case op_le: return logical_operators::not(context.less(value, property));
+            default: return value_indeterminate;
+            }
+        }
+
+        // evaluate a function of the value of an argument, which is usually a property, without copying it if possible
+        template <typename Function>
+        inline web::json::value with_property(const compiled_node& arg, const compiled_context& context, Function function)
+        {
+            if (op_property == arg.op)
+            {
+                web::json::extracted_refs refs;
+                web::json::extract(context.object, refs, arg.key_path);
+                if (!refs.arrays)
+                {
+                    return function(refs.fields.empty() ? value_indeterminate : *refs.fields.front());
+                }
+                return function(refs.value());
+            }
+            else
+            {
+                return function(evaluate(arg, context));
+            }
+        }
+
+        // evaluate whether any element of the value of an argument, which is usually a property, satisfies the predicate,
+        // without copying it (see logical_operators::any)
+        template <typename ThreeStatePredicate>
+        inline web::json::value any_property(const compiled_node& arg, const compiled_context& context, ThreeStatePredicate predicate)
+        {
+            if (op_property == arg.op)
+            {
+                web::json::extracted_refs refs;
+                web::json::extract(context.object, refs, arg.key_path);
+                if (!refs.arrays)
+                {
+                    return logical_operators::any(refs.fields.empty() ? value_indeterminate : *refs.fields.front(), predicate);
+                }
+                // the equivalent value would be an array of the matching fields, with any array fields merged
+                bool indeterminate = false;
+                for (auto field : refs.fields)
+                {
+                    auto result = logical_operators::any(*field, predicate);
+                    if (!result.is_boolean())
+                    {
+                        indeterminate = true;
+                    }
+                    else if (result.as_bool())
+                    {
+                        return value_true;
+                    }
+                }
+                return indeterminate ? value_indeterminate : value_false;
+            }
+            else
+            {
+                return logical_operators::any(evaluate(arg, context), predicate);
+            }
+        }
+
+        inline web::json::value matches(const web::json::value& target, const utility::regex_t& regex)
+        {
+            if (!target.is_string())
+            {
+                return value_indeterminate;
+            }
+            else
+            {
+                return std::regex_search(target.as_string(), regex) ? value_true : value_false;
+            }
+        }
+
+        web::json::value evaluate(const compiled_node& node, const compiled_context& context)
+        {
+            switch (node.op)
+            {
+            case op_literal:
+                return node.value;
+
+            case op_property:
+            {
+                web::json::extracted_refs refs;
+                web::json::extract(context.object, refs, node.key_path);
+                return refs.value();
+            }
+
+            case op_and:
+            case op_or:
+            {
+                // short-circuit on the first false (for and) or true (for or) result, see functions::all and functions::any
+                const bool short_circuit = op_or == node.op;
+                bool indeterminate = false;
+                for (const auto& arg : node.args)
+                {
+                    const auto result = evaluate(arg, context);
+                    if (!result.is_boolean())
+                    {
+                        indeterminate = true;
+                    }
+                    else if (short_circuit == result.as_bool())
+                    {
+                        return short_circuit ? value_true : value_false;
+                    }
+                }
+                return indeterminate ? value_indeterminate : short_circuit ? value_false : value_true;
+            }
+
+            case op_not:
+                return logical_operators::not(evaluate(node.args[0], context));
+
+            case op_eq:
+            case op_ne:
+            case op_gt:
+            case op_ge:
+            case op_lt:
+            case op_le:
+            {
+                web::json::value storage;
+                const auto& value = evaluate(node.args[1], context, storage);
+                return node.any
+                    ? any_property(node.args[0], context, [&](const web::json::value& element) { return relation(node.op, element, value, context); })
+                    : with_property(node.args[0], context, [&](const web::json::value& property) { return relation(node.op, property, value, context); });
+            }
+
+            case op_in:
+            case op_out:
+            {
+                // see details::includes
+                web::json::value storage;
+                const auto& values = evaluate(node.args[1], context, storage);
+                return with_property(node.args[0], context, [&](const web::json::value& property) -> web::json::value
+                {
+                    const bool in = value_true == logical_operators::any(values, [&](const web::json::value& element) { return context.equal_to(element, property); });
+                    return in == (op_in == node.op) ? value_true : value_false;
+                });
+            }
+
+            case op_contains:
+            case op_excludes:
+            {
+                web::json::value storage;
+                const auto& value = evaluate(node.args[1], context, storage);
+                const bool contains = value_true == any_property(node.args[0], context, [&](const web::json::value& element) { return context.equal_to(element, value); });
+                return contains == (op_contains == node.op) ? value_true : value_false;
+            }
+
+            case op_null:
+            {
+                const auto& arg = node.args[0];
+                if (op_property != arg.op)
+                {
+                    return web::json::value::null() == evaluate(arg, context) ? value_true : value_false;
+                }
+                else
+                {
+                    // can't use evaluate precisely because it doesn't distinguish a null value from property key not found
+                    web::json::extracted_refs refs;
+                    if (!web::json::extract(context.object, refs, arg.key_path))
+                    {
+                        return value_indeterminate;
+                    }
+                    // if any arrays were encountered, the equivalent value would be an array
+                    return !refs.arrays && refs.fields.front()->is_null() ? value_true : value_false;
+                }
+            }
+
+            case op_matches:
+            {
+                std::shared_ptr<const utility::regex_t> regex = node.regex;
+                if (!regex)
+                {
+                    // throws web::json::json_exception if pattern is not a string
+                    // throws std::regex_error if the pattern is not valid
+                    regex = std::make_shared<utility::regex_t>(evaluate(node.args[1], context).as_string(), node.value.as_bool() ? utility::regex_t::icase : utility::regex_t::flag_type{});
+                }
+                return node.any
+                    ? any_property(node.args[0], context, [&](const web::json::value& element) { return matches(element, *regex); })
+                    : with_property(node.args[0], context, [&](const web::json::value& target) { return matches(target, *regex); });
+            }
+
+            case op_count:
+                return with_property(node.args[0], context, [](const web::json::value& arg) -> web::json::value
+                {
+                    if (!arg.is_object() && !arg.is_array())
+                    {
+                        return value_indeterminate;
+                    }
+                    return web::json::value::number(arg.size());
+                });
+
+            case op_get:
+            {
+                web::json::extracted_refs refs;
+                web::json::extract(context.object, refs, web::json::split_key_path(evaluate(node.args[0], context).as_string()));
+                return refs.value();
+            }
+
+            case op_value:
+                return evaluate(node.args[0], context);
+
+            default:
+                return value_indeterminate;
+            }
+        }
+    }
+
+    compiled_query::compiled_query()
+    {
+    }
+
+    compiled_query::compiled_query(const web::json::value& query, comparator equal_to, comparator less, bool any_operators)
+        : root(std::make_shared<details::compiled_node>(details::compile(query, false, any_operators)))
+        , equal_to(equal_to)
+        , less(less)
+    {
+    }
+
+    compiled_query::compiled_query(const web::json::value& query, bool any_operators)
+        : root(std::make_shared<details::compiled_node>(details::compile(query, false, any_operators)))
+        , equal_to(default_equal_to)
+        , less(default_less)
+    {
+    }
+
+    web::json::value compiled_query::operator()(const web::json::object& object) const
+    {
+        if (!root) return value_true;
+        return details::evaluate(*root, { object, equal_to, less });
+    }
 }
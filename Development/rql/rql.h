@@ -2,6 +2,7 @@
 #define RQL_RQL_H
 
 #include <functional>
+#include <memory>
 #include <unordered_map>
 #include "cpprest/json.h"
 
@@ -65,6 +66,33 @@ namespace rql
 
     web::json::value default_equal_to(const web::json::value& lhs, const web::json::value& rhs);
     web::json::value default_less(const web::json::value& lhs, const web::json::value& rhs);
+
+    // Compile an RQL query for evaluating against many json objects, equivalent to an evaluator extracting properties from each
+    // object with web::json::extract, but with the call-operators resolved, property keys split, and regex patterns constructed
+    // once up front, rather than for every object
+    // Only the default call-operators, or their array-friendly variants, are supported; throws std::out_of_range for others
+
+    namespace details
+    {
+        struct compiled_node;
+    }
+
+    class compiled_query
+    {
+    public:
+        // the default query matches any object
+        compiled_query();
+        compiled_query(const web::json::value& query, comparator equal_to, comparator less, bool any_operators = true);
+        explicit compiled_query(const web::json::value& query, bool any_operators = true); // using default json value comparison
+
+        // result is value_true, value_false or value_indeterminate (unless the query is e.g. a count)
+        web::json::value operator()(const web::json::object& object) const;
+
+    private:
+        std::shared_ptr<const details::compiled_node> root;
+        comparator equal_to;
+        comparator less;
+    };
 }
 
 #endif
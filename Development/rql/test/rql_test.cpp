@@ -0,0 +1,128 @@
+// The first "test" is of course whether the header compiles standalone
+#include "rql/rql.h"
+
+#include <chrono>
+#include <stdexcept>
+#include <vector>
+#include "cpprest/basic_utils.h"
+#include "cpprest/json_utils.h"
+#include "bst/test/test.h"
+
+namespace
+{
+    web::json::value evaluate(const web::json::value& value, const web::json::value& query, bool any_operators)
+    {
+        return rql::evaluator
+        {
+            [&value](web::json::value& results, const web::json::value& key)
+            {
+                return web::json::extract(value.as_object(), results, key.as_string());
+            },
+            any_operators ? rql::default_any_operators() : rql::default_operators()
+        }(query);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testCompiledQuery)
+{
+    const auto value = web::json::value::parse(U("{\"label\":\"Foo Bar\",\"count\":42,\"enabled\":true,\"nothing\":null,\"tags\":[\"baz\",\"qux\"],\"caps\":{\"media_types\":[\"video/raw\",\"video/smpte291\"]},\"interfaces\":[{\"name\":\"eth0\"},{\"name\":\"eth1\"}]}"));
+
+    // the compiled query must give the same result as the evaluator, whatever the query and operators
+    const utility::char_t* queries[] =
+    {
+        U("eq(label,Foo%20Bar)"),
+        U("ne(label,Foo%20Bar)"),
+        U("eq(count,42)"),
+        U("gt(count,41)"),
+        U("ge(count,43)"),
+        U("lt(count,43)"),
+        U("le(count,41)"),
+        U("lt(label,string:G)"),
+        U("eq(enabled,true)"),
+        U("eq(tags,qux)"),
+        U("ne(tags,qux)"),
+        U("eq(caps.media_types,video/raw)"),
+        U("eq(interfaces.name,eth1)"),
+        U("eq(missing,foo)"),
+        U("in(count,(41,42,43))"),
+        U("out(count,(41,42,43))"),
+        U("contains(tags,baz)"),
+        U("excludes(tags,baz)"),
+        U("null(nothing)"),
+        U("null(label)"),
+        U("null(missing)"),
+        U("matches(label,foo,i)"),
+        U("matches(label,foo)"),
+        U("matches(tags,^q)"),
+        U("eq(count(tags),2)"),
+        U("eq(get(value(label)),Foo%20Bar)"),
+        U("and(eq(count,42),matches(label,bar,i))"),
+        U("and(eq(count,42),eq(missing,foo))"),
+        U("and(eq(count,42),gt(label,1))"),
+        U("or(eq(count,41),eq(enabled,true))"),
+        U("or(eq(count,41),gt(label,1))"),
+        U("not(eq(count,42))"),
+        U("not(gt(label,1))")
+    };
+
+    for (auto query_text : queries)
+    {
+        const auto query = rql::parse_query(query_text);
+        for (bool any_operators : { false, true })
+        {
+            const rql::compiled_query compiled(query, any_operators);
+            BST_REQUIRE_EQUAL(evaluate(value, query, any_operators), compiled(value.as_object()));
+        }
+    }
+
+    // the default query matches any object
+    BST_REQUIRE_EQUAL(rql::value_true, rql::compiled_query()(value.as_object()));
+
+    // unsupported call-operators
+    BST_REQUIRE_THROW(rql::compiled_query(rql::parse_query(U("foo(label,bar)"))), std::out_of_range);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_BENCHMARK_CASE(testCompiledQueryBenchmark)
+{
+    // compare evaluating a typical query against 10k objects with the evaluator and with the compiled query
+    const size_t count = 10000;
+
+    std::vector<web::json::value> values;
+    for (size_t i = 0; i < count; ++i)
+    {
+        web::json::value value;
+        value[U("label")] = web::json::value::string(U("Sender ") + utility::ostringstreamed(i));
+        value[U("format")] = web::json::value::string(0 == i % 2 ? U("urn:x-nmos:format:video") : U("urn:x-nmos:format:audio"));
+        value[U("tags")][U("location")] = web::json::value_of({ web::json::value::string(U("Studio ") + utility::ostringstreamed(i % 10)) });
+        values.push_back(value);
+    }
+
+    const auto query = rql::parse_query(U("and(eq(format,urn%3Ax-nmos%3Aformat%3Avideo),eq(tags.location,Studio%204),matches(label,1,i))"));
+
+    size_t evaluated_count = 0;
+    const auto evaluated_start = std::chrono::steady_clock::now();
+    for (const auto& value : values)
+    {
+        if (rql::value_true == evaluate(value, query, true)) ++evaluated_count;
+    }
+    const auto evaluated_duration = std::chrono::steady_clock::now() - evaluated_start;
+
+    const rql::compiled_query compiled(query);
+
+    size_t compiled_count = 0;
+    const auto compiled_start = std::chrono::steady_clock::now();
+    for (const auto& value : values)
+    {
+        if (rql::value_true == compiled(value.as_object())) ++compiled_count;
+    }
+    const auto compiled_duration = std::chrono::steady_clock::now() - compiled_start;
+
+    BST_REQUIRE_NE(0, compiled_count);
+    BST_REQUIRE_EQUAL(evaluated_count, compiled_count);
+
+    BST_MESSAGE("query of 3 terms, per-object evaluation: "
+        << std::chrono::duration_cast<std::chrono::nanoseconds>(evaluated_duration).count() / count << "ns with the evaluator, "
+        << std::chrono::duration_cast<std::chrono::nanoseconds>(compiled_duration).count() / count << "ns compiled");
+}